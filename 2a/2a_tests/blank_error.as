@@ -0,0 +1,4 @@
+	lw	0	1	five
+
+	halt
+five	.fill	5
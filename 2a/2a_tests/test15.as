@@ -0,0 +1,9 @@
+start	lw	0	1	counter
+	lw	0	2	NegativeOne
+loop	add	1	2	1
+	beq	0	1	finished
+	beq	0	0	loop
+finished	halt
+counter	.fill	5
+LongGlobalName	.fill	start
+	.fill	ExternalSymbol
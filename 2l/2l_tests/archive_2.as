@@ -0,0 +1 @@
+Bar	.fill	7
@@ -0,0 +1,11 @@
+	lw	0	1	Count	load a global of the other module
+	lw	0	4	SubAdr
+	jalr	4	7	call Sub
+	sw	0	1	Result
+	lw	0	2	local
+	add	1	2	1
+	sw	0	1	Stack	push the result
+	halt
+local	.fill	3
+Result	.fill	0
+	.fill	Stack
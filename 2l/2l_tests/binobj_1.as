@@ -0,0 +1,7 @@
+Sub	lw	0	3	one
+	add	1	3	1
+	jalr	7	6	return
+Count	.fill	4
+SubAdr	.fill	Sub
+one	.fill	1
+	.fill	Result
@@ -0,0 +1,16 @@
+	lw	0	2	neg	count down from 5 with a fused lw and beq
+loop	lw	0	1	count
+	beq	1	0	done
+	add	1	2	1
+	sw	0	1	count
+	beq	0	0	loop
+done	lw	0	3	h	rewrite the noop below into a halt
+	sw	0	3	tgt
+	noop
+	noop
+tgt	noop
+	add	2	2	2	not reached
+	halt
+count	.fill	5
+neg	.fill	-1
+h	.fill	25165824
@@ -0,0 +1,5 @@
+	lw	0	1	Foo
+	lw	0	2	Bar
+	nor	1	2	1	only this instruction changed
+	sw	0	1	Stack
+	halt
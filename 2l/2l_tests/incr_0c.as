@@ -0,0 +1,5 @@
+	lw	0	1	Bar	Foo is no longer needed
+	lw	0	2	Bar
+	nor	1	2	1
+	sw	0	1	Stack
+	halt
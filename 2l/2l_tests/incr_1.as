@@ -0,0 +1,3 @@
+Foo	lw	0	3	Baz
+	noop
+	.fill	Baz
@@ -0,0 +1,2 @@
+	noop
+Baz	.fill	5
@@ -0,0 +1,2 @@
+Unused	lw	0	1	Missing
+	halt
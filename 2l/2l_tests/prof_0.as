@@ -0,0 +1,10 @@
+Main	lw	0	1	Times	call Twice Times times
+	lw	0	2	neg
+	lw	0	4	TwiceA
+loop	beq	1	0	done
+	jalr	4	7
+	add	1	2	1
+	beq	0	0	loop
+done	halt
+neg	.fill	-1
+Times	.fill	6
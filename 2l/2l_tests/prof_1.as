@@ -0,0 +1,7 @@
+Twice	add	3	3	3	double reg3, skipping the add when it is zero
+	beq	3	0	zero
+	jalr	7	6
+zero	lw	0	3	one
+	jalr	7	6
+one	.fill	1
+TwiceA	.fill	Twice
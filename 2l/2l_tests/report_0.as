@@ -0,0 +1,8 @@
+Main	lw	0	1	Count	global data of the other module
+	lw	0	2	inc
+	lw	0	4	SubAdr
+	jalr	4	7	call Sub
+	sw	0	1	Stack
+	halt
+inc	.fill	1
+top	.fill	Stack
@@ -0,0 +1,8 @@
+Sub	add	1	2	1
+	beq	0	0	done
+	noop
+done	jalr	7	6
+Count	.fill	9
+SubAdr	.fill	Sub
+back	.fill	Main
+self	.fill	back
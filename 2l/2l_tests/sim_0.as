@@ -0,0 +1,9 @@
+Main	lw	0	1	N	count N down to zero through Dec
+	lw	0	4	DecAdr
+loop	beq	1	0	done
+	jalr	4	7
+	beq	0	0	loop
+done	nor	1	1	3
+	sw	0	3	Stack
+	noop
+	halt
@@ -0,0 +1,6 @@
+Dec	lw	0	2	neg
+	add	1	2	1
+	jalr	7	6
+N	.fill	3
+DecAdr	.fill	Dec
+neg	.fill	-1
@@ -0,0 +1,6 @@
+Start	lw	0	1	Total	the other module defines Total
+	lw	0	2	step
+	add	1	2	1
+	sw	0	1	Stack
+	halt
+step	.fill	5
@@ -0,0 +1,2 @@
+Total	.fill	37
+	.fill	Start
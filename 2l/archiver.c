@@ -0,0 +1,137 @@
+/**
+ * Project 2
+ * Packs LC-2K object files into an archive indexed by the global symbols
+ * they define, for the linker to search
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "archive.h"
+#include "object.h"
+#include "outbuf.h"
+
+// Orders symbols by label, then by member.
+static int
+compareSymbols(const void *a, const void *b)
+{
+	const ArchiveSymbol *left = a, *right = b;
+	int order = strcmp(left->label, right->label);
+	return order ? order : left->member - right->member;
+}
+
+// Returns allocation, exiting if memory ran out.
+static void *
+checkMemory(void *allocation)
+{
+	if (allocation == NULL)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	return allocation;
+}
+
+int main(int argc, char *argv[])
+{
+	char *outFileStr;
+	OutputBuffer out;
+	Arena arena = {NULL};
+
+	if (argc <= 2)
+	{
+		printf("error: usage: %s <library-file> <object-file> ...\n", argv[0]);
+		exit(1);
+	}
+	outFileStr = argv[1];
+
+	int memberCount = argc - 2;
+	ArchiveMember *members = checkMemory(arenaAlloc(&arena, memberCount * sizeof(ArchiveMember)));
+	bool *mapped = checkMemory(arenaAlloc(&arena, memberCount * sizeof(bool)));
+	int symbolCount = 0;
+	int symbolCapacity = 0;
+	ArchiveSymbol *symbols = NULL;
+
+	for (int i = 0; i < memberCount; ++i)
+	{
+		char *path = argv[i + 2];
+		ArchiveMember *member = &members[i];
+		if (loadFile(path, &member->bytes, &member->size, &mapped[i]) != 0)
+		{
+			printf("error in opening %s\n", path);
+			exit(1);
+		}
+		// members are named without their directories
+		char *slash = strrchr(path, '/');
+		member->name = slash != NULL ? slash + 1 : path;
+
+		// the member is stored as is, so it is checked here rather than at link time
+		ObjectFile object;
+		int result = readObjectBuffer(member->bytes, member->size, &object);
+		if (result == -3)
+		{
+			printf("error: out of memory\n");
+			exit(1);
+		}
+		if (result != 0)
+		{
+			printf("error: %s is not a valid object file\n", path);
+			exit(1);
+		}
+
+		// index every symbol the member defines
+		for (int j = 0; j < object.symbolTableSize; ++j)
+		{
+			ObjectSymbol *symbol = &object.symbols[j];
+			if (symbol->area == 'U')
+				continue;
+			if (symbolCount == symbolCapacity)
+			{
+				symbolCapacity = symbolCapacity ? 2 * symbolCapacity : 64;
+				ArchiveSymbol *grown = checkMemory(arenaAlloc(&arena, symbolCapacity * sizeof(ArchiveSymbol)));
+				if (symbolCount)
+					memcpy(grown, symbols, symbolCount * sizeof(ArchiveSymbol));
+				symbols = grown;
+			}
+			symbols[symbolCount].label = checkMemory(arenaString(&arena, symbol->label, symbol->length));
+			symbols[symbolCount].member = i;
+			++symbolCount;
+		}
+		freeObject(&object);
+	}
+
+	// the linker could only ever pull in one definition of a label
+	ArchiveSymbol *sorted = checkMemory(arenaAlloc(&arena, (symbolCount + 1) * sizeof(ArchiveSymbol)));
+	if (symbolCount)
+		memcpy(sorted, symbols, symbolCount * sizeof(ArchiveSymbol));
+	qsort(sorted, symbolCount, sizeof(ArchiveSymbol), compareSymbols);
+	for (int i = 1; i < symbolCount; ++i)
+	{
+		if (!strcmp(sorted[i - 1].label, sorted[i].label))
+		{
+			printf("error: %s defines %s, already defined by %s\n", argv[sorted[i].member + 2],
+				   sorted[i].label, argv[sorted[i - 1].member + 2]);
+			exit(1);
+		}
+	}
+
+	if (openOutput(&out, outFileStr) != 0)
+	{
+		printf("error in opening %s\n", outFileStr);
+		exit(1);
+	}
+	writeArchive(&out, members, memberCount, symbols, symbolCount);
+	if (closeOutput(&out) != 0)
+	{
+		printf("error in writing %s\n", outFileStr);
+		exit(1);
+	}
+
+	for (int i = 0; i < memberCount; ++i)
+		unloadFile(members[i].bytes, members[i].size, mapped[i]);
+	arenaFree(&arena);
+	return (0);
+}
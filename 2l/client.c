@@ -0,0 +1,139 @@
+/**
+ * Project 2
+ * Runs an LC-2K assembler or linker command on the server. Named (or linked
+ * as) assembler or linker, it takes the same arguments, prints the same
+ * output and exits with the same status, so it stands in for either.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "request.h"
+
+static char *readInput(size_t *size);
+
+int main(int argc, char *argv[])
+{
+	Request request;
+	char cwd[PATH_MAX];
+	memset(&request, 0, sizeof(request));
+
+	// the tool is the one the client is named after, or else the first argument
+	const char *name = strrchr(argv[0], '/');
+	name = name != NULL ? name + 1 : argv[0];
+	if (strstr(name, "linker") != NULL)
+		request.tool = TOOL_LINKER;
+	else if (strstr(name, "assembler") != NULL)
+		request.tool = TOOL_ASSEMBLER;
+	else if (argc > 1 && (!strcmp(argv[1], "assembler") || !strcmp(argv[1], "linker")))
+	{
+		request.tool = argv[1][0] == 'a' ? TOOL_ASSEMBLER : TOOL_LINKER;
+		--argc;
+		++argv;
+	}
+	else
+	{
+		printf("error: usage: %s assembler|linker <argument>...\n", argv[0]);
+		exit(1);
+	}
+
+	const char *socketFileStr = getenv(SERVERENV);
+	if (socketFileStr == NULL || *socketFileStr == '\0')
+	{
+		printf("error: %s does not name the server's socket\n", SERVERENV);
+		exit(1);
+	}
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+	{
+		printf("error in opening .\n");
+		exit(1);
+	}
+
+	request.argc = argc;
+	request.argv = argv;
+	request.cwd = cwd;
+	request.umask = umask(0);
+	umask(request.umask);
+	request.input = "";
+
+	// a source named "-" is the client's standard input
+	for (int i = 1; i < argc && request.tool == TOOL_ASSEMBLER; ++i)
+	{
+		if (!strcmp(argv[i], "-"))
+		{
+			request.input = readInput(&request.inputSize);
+			break;
+		}
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(socketFileStr) >= sizeof(address.sun_path))
+	{
+		printf("error: socket name %s is too long\n", socketFileStr);
+		exit(1);
+	}
+	strcpy(address.sun_path, socketFileStr);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+	{
+		printf("error: cannot reach the server at %s\n", socketFileStr);
+		exit(1);
+	}
+
+	int status;
+	char *output;
+	size_t size;
+	if (sendRequest(fd, &request) != 0 || receiveResponse(fd, &status, &output, &size) != 0)
+	{
+		printf("error: lost the server at %s\n", socketFileStr);
+		exit(1);
+	}
+	close(fd);
+	fwrite(output, 1, size, stdout);
+	exit(status);
+
+} // main
+
+// Reads all of standard input into a heap buffer.
+static char *
+readInput(size_t *size)
+{
+	size_t capacity = 1 << 16;
+	size_t length = 0;
+	char *input = malloc(capacity);
+	while (input != NULL)
+	{
+		length += fread(input + length, 1, capacity - length, stdin);
+		if (length < capacity)
+			break;
+		capacity *= 2;
+		char *grown = realloc(input, capacity);
+		if (grown == NULL)
+			free(input);
+		input = grown;
+	}
+	if (input == NULL)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	// a failed read must not reach the server as a shorter source
+	if (ferror(stdin))
+	{
+		printf("error in reading standard input\n");
+		exit(1);
+	}
+	*size = length;
+	return input;
+}
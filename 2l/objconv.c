@@ -0,0 +1,73 @@
+/**
+ * Project 2
+ * Converts LC-2K object files between the text and binary formats
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object.h"
+#include "outbuf.h"
+
+int main(int argc, char *argv[])
+{
+	char *inFileStr, *outFileStr;
+	OutputBuffer out;
+	int format = -1; // by default, convert to the other format
+
+	if (argc == 4 && (!strcmp(argv[1], "-t") || !strcmp(argv[1], "-b")))
+	{
+		format = argv[1][1] == 'b' ? OBJECT_BINARY : OBJECT_TEXT;
+		--argc;
+		++argv;
+	}
+	if (argc != 3)
+	{
+		printf("error: usage: %s [-t | -b] <object-file> <output-object-file>\n",
+			   argv[0]);
+		exit(1);
+	}
+
+	inFileStr = argv[1];
+	outFileStr = argv[2];
+
+	ObjectFile object;
+	int result = readObject(inFileStr, &object);
+	if (result == -1)
+	{
+		printf("error in opening %s\n", inFileStr);
+		exit(1);
+	}
+	if (result == -3)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	if (result != 0)
+	{
+		printf("error: %s is not a valid object file\n", inFileStr);
+		exit(1);
+	}
+	if (format < 0)
+		format = object.format == OBJECT_TEXT ? OBJECT_BINARY : OBJECT_TEXT;
+
+	if (openOutput(&out, outFileStr) != 0)
+	{
+		printf("error in opening %s\n", outFileStr);
+		exit(1);
+	}
+	if (writeObject(&out, &object, format) != 0)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	if (closeOutput(&out) != 0)
+	{
+		printf("error in writing %s\n", outFileStr);
+		exit(1);
+	}
+
+	freeObject(&object);
+	return (0);
+}
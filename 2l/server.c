@@ -0,0 +1,655 @@
+/**
+ * Project 2
+ * LC-2K assembler and linker server. It runs the command lines that clients
+ * send over a Unix socket on a pool of threads, and keeps the object files it
+ * has assembled or read in memory, so that a build step whose inputs did not
+ * change costs a round trip instead of a new process.
+ */
+
+#define _GNU_SOURCE // for unshare, which gives each worker its own working directory
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "assemble.h"
+#include "command.h"
+#include "diagnostic.h"
+#include "link.h"
+#include "object.h"
+#include "outbuf.h"
+#include "request.h"
+
+// Each cache drops its least recently used entries once it holds more bytes.
+#define CACHELIMIT (1 << 28)
+
+// Initial number of slots of a cache; it doubles whenever it holds as many entries.
+#define INITIALSLOTS 256
+
+// Accepted connections wait for a worker in a ring of this many; accepting
+// stops while it is full.
+#define QUEUESIZE 1024
+
+// Seconds a connection may stall while its request is read or its response
+// written before it is dropped, so that a stalled client cannot hold a
+// worker.
+#define STALLTIMEOUT 10
+
+typedef struct CacheEntry CacheEntry;
+typedef struct Cache Cache;
+typedef struct ConnectionQueue ConnectionQueue;
+typedef struct Server Server;
+
+// The bytes cached under key, valid while the file the key names still has
+// fingerprint. An entry is freed when it has been dropped from the cache and
+// the last request using it releases it.
+struct CacheEntry
+{
+	Fingerprint fingerprint;
+	char *bytes;
+	size_t size;
+	unsigned int refs; // one while the cache holds it, plus one per request using it
+	unsigned int hash;
+	CacheEntry *next;  // in the same slot
+	CacheEntry *newer; // in order of use
+	CacheEntry *older;
+	char key[];
+};
+
+// A hash of entries by key, chained per slot, and the list of entries from
+// the most recently used (newest) to the least (oldest). numSlots is a power
+// of two.
+struct Cache
+{
+	CacheEntry **slots;
+	unsigned int numSlots;
+	unsigned int count;
+	size_t size; // bytes held
+	CacheEntry *newest;
+	CacheEntry *oldest;
+	pthread_mutex_t lock;
+};
+
+// Accepted connections, in order, for whichever worker is idle next.
+struct ConnectionQueue
+{
+	int fds[QUEUESIZE];
+	unsigned int head;
+	unsigned int count;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	pthread_cond_t room;
+};
+
+// objects holds assembled objects by source file and format; files holds
+// the bytes of the object files and archives linked or written so far.
+struct Server
+{
+	Cache objects;
+	Cache files;
+	ConnectionQueue queue;
+};
+
+static void *serveWorker(void *arg);
+static void serveConnection(Server *server, int fd);
+static int runAssembler(Server *server, Request *request, FILE *out);
+static int assembleJob(Server *server, Request *request, AssemblyJob *job);
+static int runLinker(Server *server, Request *request, FILE *out);
+static int outOfMemory(FILE *out);
+static char *cacheKey(Request *request, const char *prefix, const char *path);
+static CacheEntry *cachedFile(Server *server, Request *request, const char *path);
+static void initCache(Cache *cache);
+static CacheEntry *findCached(Cache *cache, const char *key, Fingerprint *fingerprint);
+static CacheEntry *storeCached(Cache *cache, const char *key, Fingerprint *fingerprint, char *bytes, size_t size);
+static void releaseCached(Cache *cache, CacheEntry *entry);
+
+int main(int argc, char *argv[])
+{
+	char *socketFileStr;
+	Server server;
+
+	if (argc != 2)
+	{
+		printf("error: usage: %s <socket-file>\n"
+			   "       clients find the socket through the %s environment variable\n",
+			   argv[0], SERVERENV);
+		exit(1);
+	}
+	socketFileStr = argv[1];
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(socketFileStr) >= sizeof(address.sun_path))
+	{
+		printf("error: socket name %s is too long\n", socketFileStr);
+		exit(1);
+	}
+	strcpy(address.sun_path, socketFileStr);
+
+	// a socket left by a server that is gone is replaced; any other file is kept
+	struct stat info;
+	if (lstat(socketFileStr, &info) == 0 && S_ISSOCK(info.st_mode))
+		unlink(socketFileStr);
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+		listen(listener, QUEUESIZE) != 0)
+	{
+		printf("error in opening %s\n", socketFileStr);
+		exit(1);
+	}
+
+	// a client that goes away only fails the write of its response
+	signal(SIGPIPE, SIG_IGN);
+
+	initCache(&server.objects);
+	initCache(&server.files);
+	server.queue.head = 0;
+	server.queue.count = 0;
+	pthread_mutex_init(&server.queue.lock, NULL);
+	pthread_cond_init(&server.queue.ready, NULL);
+	pthread_cond_init(&server.queue.room, NULL);
+
+	// one worker per online CPU
+	long numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (numWorkers < 1)
+		numWorkers = 1;
+	for (long i = 0; i < numWorkers; ++i)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, serveWorker, &server) != 0)
+		{
+			printf("error: cannot start the server's workers\n");
+			exit(1);
+		}
+		pthread_detach(thread);
+	}
+
+	ConnectionQueue *queue = &server.queue;
+	for (;;)
+	{
+		int fd = accept(listener, NULL, NULL);
+		if (fd < 0)
+		{
+			// out of descriptors: wait for a connection to be served
+			if (errno != EINTR && errno != ECONNABORTED)
+				sleep(1);
+			continue;
+		}
+		struct timeval timeout = {STALLTIMEOUT, 0};
+		if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 ||
+			setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0)
+		{
+			close(fd);
+			continue;
+		}
+		pthread_mutex_lock(&queue->lock);
+		while (queue->count == QUEUESIZE)
+			pthread_cond_wait(&queue->room, &queue->lock);
+		queue->fds[(queue->head + queue->count) % QUEUESIZE] = fd;
+		++queue->count;
+		pthread_cond_signal(&queue->ready);
+		pthread_mutex_unlock(&queue->lock);
+	}
+
+} // main
+
+// Serves connections as they are queued. Every command runs in the working
+// directory of its client, which the worker alone changes: unshare gives it
+// its own, which the threads the linker starts from it share.
+static void *
+serveWorker(void *arg)
+{
+	Server *server = arg;
+	ConnectionQueue *queue = &server->queue;
+	if (unshare(CLONE_FS) != 0)
+	{
+		printf("error: cannot give the server's workers their own working directories\n");
+		exit(1);
+	}
+	for (;;)
+	{
+		pthread_mutex_lock(&queue->lock);
+		while (queue->count == 0)
+			pthread_cond_wait(&queue->ready, &queue->lock);
+		int fd = queue->fds[queue->head];
+		queue->head = (queue->head + 1) % QUEUESIZE;
+		--queue->count;
+		pthread_cond_signal(&queue->room);
+		pthread_mutex_unlock(&queue->lock);
+		serveConnection(server, fd);
+	}
+}
+
+// Runs the one request of a connection and answers it with what the command
+// would have printed and its exit status.
+static void
+serveConnection(Server *server, int fd)
+{
+	Request request;
+	if (receiveRequest(fd, &request) != 0)
+	{
+		close(fd);
+		return;
+	}
+
+	char *output = NULL;
+	size_t size = 0;
+	FILE *out = open_memstream(&output, &size);
+	if (out == NULL)
+	{
+		const char *message = "error: out of memory\n";
+		sendResponse(fd, 1, message, strlen(message));
+		freeRequest(&request);
+		close(fd);
+		return;
+	}
+
+	int status;
+	umask(request.umask & 0777);
+	if (chdir(request.cwd) != 0)
+	{
+		fprintf(out, "error in opening %s\n", request.cwd);
+		status = 1;
+	}
+	else if (request.tool == TOOL_ASSEMBLER)
+		status = runAssembler(server, &request, out);
+	else
+		status = runLinker(server, &request, out);
+
+	fclose(out);
+	sendResponse(fd, status, output, size);
+	free(output);
+	freeRequest(&request);
+	close(fd);
+}
+
+// Runs the assembler command line of request, printing to out what the
+// assembler would. Returns its exit status. A batch runs on this worker;
+// concurrent requests are what spread over the pool.
+static int
+runAssembler(Server *server, Request *request, FILE *out)
+{
+	AssemblerCommand command;
+	Diagnostic diagnostic;
+	if (parseAssemblerCommand(request->argc, request->argv, &request->arena, &command, &diagnostic) != 0)
+	{
+		fprintf(out, "%s", diagnostic.message);
+		return diagnostic.status;
+	}
+	int numJobs = command.numSources;
+	AssemblyJob *jobs = arenaAlloc(&request->arena, (numJobs + 1) * sizeof(AssemblyJob));
+	if (jobs == NULL)
+		return outOfMemory(out);
+	for (int i = 0; i < numJobs; ++i)
+	{
+		jobs[i].inFileString = command.sources[i].inFileString;
+		jobs[i].outFileString = command.sources[i].outFileString;
+		jobs[i].format = command.format;
+	}
+
+	if (!command.batch)
+	{
+		if (assembleJob(server, request, &jobs[0]) != 0)
+		{
+			fprintf(out, "%s", jobs[0].diagnostic.message);
+			return jobs[0].diagnostic.status;
+		}
+		return 0;
+	}
+
+	for (int i = 0; i < numJobs; ++i)
+		assembleJob(server, request, &jobs[i]);
+	return reportAssembly(out, jobs, numJobs);
+}
+
+// Assembles one source the way the assembler command does, reusing the
+// object cached for it if the source has not changed, and caches the object
+// file written for the linker. Returns 0 on success; otherwise job's
+// diagnostic says why.
+static int
+assembleJob(Server *server, Request *request, AssemblyJob *job)
+{
+	Diagnostic *diagnostic = &job->diagnostic;
+	clearDiagnostic(diagnostic);
+
+	// a source named "-" is the client's standard input, which is not cached
+	Fingerprint fingerprint;
+	char *key = NULL;
+	CacheEntry *entry = NULL;
+	if (strcmp(job->inFileString, "-") && takeFingerprint(job->inFileString, &fingerprint) == 0)
+	{
+		// without memory for the key the source is just not cached
+		key = cacheKey(request, job->format == OBJECT_BINARY ? "b:" : "t:", job->inFileString);
+		if (key != NULL)
+			entry = findCached(&server->objects, key, &fingerprint);
+	}
+
+	char *object = NULL;
+	const char *bytes = NULL;
+	size_t size = 0;
+	int status;
+	if (entry != NULL)
+	{
+		bytes = entry->bytes;
+		size = entry->size;
+		status = writeAssembly(job, 0, bytes, size);
+	}
+	else
+	{
+		const char *source = request->input;
+		size_t sourceSize = request->inputSize;
+		bool mapped = false;
+		bool loaded = strcmp(job->inFileString, "-") != 0;
+		if (loaded && loadSource(job, &source, &sourceSize, &mapped) != 0)
+			return diagnostic->status;
+		status = assembleFile(job, source, sourceSize, &object, &size);
+		if (loaded)
+			unloadFile(source, sourceSize, mapped);
+		bytes = object;
+	}
+
+	if (status == 0)
+	{
+		// the object file just written is what the next link reads
+		Fingerprint written;
+		char *writtenKey = cacheKey(request, "", job->outFileString);
+		char *copy = malloc(size + 1);
+		if (copy != NULL && writtenKey != NULL && takeFingerprint(job->outFileString, &written) == 0)
+		{
+			memcpy(copy, bytes, size);
+			releaseCached(&server->files, storeCached(&server->files, writtenKey, &written, copy, size));
+		}
+		else
+			free(copy);
+		if (object != NULL && key != NULL)
+		{
+			releaseCached(&server->objects, storeCached(&server->objects, key, &fingerprint, object, size));
+			object = NULL;
+		}
+	}
+	free(object);
+	releaseCached(&server->objects, entry);
+	return status;
+}
+
+// Runs the linker command line of request, printing to out what the linker
+// would. Returns its exit status. Inputs come from the cache unless the link
+// is incremental, which needs to see the files themselves.
+static int
+runLinker(Server *server, Request *request, FILE *out)
+{
+	LinkerCommand command;
+	Diagnostic diagnostic;
+	if (parseLinkerCommand(request->argc, request->argv, &request->arena, &command, &diagnostic) != 0)
+	{
+		fprintf(out, "%s", diagnostic.message);
+		return diagnostic.status;
+	}
+	LinkJob job = {command.inputs, command.numInputs, command.streaming, command.incremental, out, NULL};
+	const char *reportFileStr = command.reportFileString;
+
+	CacheEntry **entries = arenaAlloc(&request->arena, (job.numInputs + 1) * sizeof(CacheEntry *));
+	if (entries == NULL)
+		return outOfMemory(out);
+	for (int i = 0; i < job.numInputs; ++i)
+	{
+		// an input that cannot be read is left for the link to report
+		entries[i] = job.incremental ? NULL : cachedFile(server, request, job.inputs[i].name);
+		job.inputs[i].bytes = entries[i] != NULL ? entries[i]->bytes : NULL;
+		job.inputs[i].size = entries[i] != NULL ? entries[i]->size : 0;
+	}
+	int status = 1;
+	if (reportFileStr != NULL && (job.report = fopen(reportFileStr, "w")) == NULL)
+		fprintf(out, "error in opening %s\n", reportFileStr);
+	else if ((status = linkFile(&job, command.outFileString)) != 0)
+		fprintf(out, "%s", job.diagnostic.message);
+	if (job.report != NULL && fclose(job.report) != 0 && status == 0)
+	{
+		fprintf(out, "error in writing %s\n", reportFileStr);
+		status = 1;
+	}
+	for (int i = 0; i < job.numInputs; ++i)
+		releaseCached(&server->files, entries[i]);
+	return status;
+}
+
+// Reports that a request ran out of memory; the worker carries on with the
+// next one. Returns the exit status.
+static int
+outOfMemory(FILE *out)
+{
+	fprintf(out, "error: out of memory\n");
+	return 1;
+}
+
+// Returns prefix followed by the absolute name of path for the client, in
+// the request's arena, or NULL if memory ran out.
+static char *
+cacheKey(Request *request, const char *prefix, const char *path)
+{
+	const char *cwd = path[0] == '/' ? "" : request->cwd;
+	const char *separator = path[0] == '/' ? "" : "/";
+	size_t length = strlen(prefix) + strlen(cwd) + strlen(separator) + strlen(path) + 1;
+	char *key = arenaAlloc(&request->arena, length);
+	if (key == NULL)
+		return NULL;
+	snprintf(key, length, "%s%s%s%s", prefix, cwd, separator, path);
+	return key;
+}
+
+// Returns the cached bytes of the file at path, reading them if the file
+// changed since they were cached, or NULL if it cannot be read. The file is
+// fingerprinted before it is read, so a change while reading it is seen by
+// the next request.
+static CacheEntry *
+cachedFile(Server *server, Request *request, const char *path)
+{
+	Fingerprint fingerprint;
+	if (takeFingerprint(path, &fingerprint) != 0)
+		return NULL;
+	char *key = cacheKey(request, "", path);
+	if (key == NULL)
+		return NULL;
+	CacheEntry *entry = findCached(&server->files, key, &fingerprint);
+	if (entry != NULL)
+		return entry;
+
+	const char *buffer;
+	size_t size;
+	bool mapped;
+	if (loadFile(path, &buffer, &size, &mapped) != 0)
+		return NULL;
+	char *bytes = malloc(size + 1);
+	if (bytes != NULL)
+		memcpy(bytes, buffer, size);
+	unloadFile(buffer, size, mapped);
+	if (bytes == NULL)
+		return NULL;
+	return storeCached(&server->files, key, &fingerprint, bytes, size);
+}
+
+static void
+initCache(Cache *cache)
+{
+	cache->numSlots = INITIALSLOTS;
+	cache->slots = calloc(cache->numSlots, sizeof(CacheEntry *));
+	if (cache->slots == NULL)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	cache->count = 0;
+	cache->size = 0;
+	cache->newest = NULL;
+	cache->oldest = NULL;
+	pthread_mutex_init(&cache->lock, NULL);
+}
+
+// The functions below up to findCached are called with the cache locked.
+
+static CacheEntry *
+lookupEntry(Cache *cache, const char *key, unsigned int hash)
+{
+	CacheEntry *entry = cache->slots[hash & (cache->numSlots - 1)];
+	while (entry != NULL && (entry->hash != hash || strcmp(entry->key, key)))
+		entry = entry->next;
+	return entry;
+}
+
+static void
+unlinkRecent(Cache *cache, CacheEntry *entry)
+{
+	if (entry->newer != NULL)
+		entry->newer->older = entry->older;
+	else
+		cache->newest = entry->older;
+	if (entry->older != NULL)
+		entry->older->newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
+}
+
+static void
+linkNewest(Cache *cache, CacheEntry *entry)
+{
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if (cache->newest != NULL)
+		cache->newest->newer = entry;
+	else
+		cache->oldest = entry;
+	cache->newest = entry;
+}
+
+static void
+freeEntry(CacheEntry *entry)
+{
+	free(entry->bytes);
+	free(entry);
+}
+
+// Removes entry from the cache; it is freed once no request uses it.
+static void
+dropEntry(Cache *cache, CacheEntry *entry)
+{
+	CacheEntry **link = &cache->slots[entry->hash & (cache->numSlots - 1)];
+	while (*link != entry)
+		link = &(*link)->next;
+	*link = entry->next;
+	unlinkRecent(cache, entry);
+	cache->size -= entry->size;
+	--cache->count;
+	if (--entry->refs == 0)
+		freeEntry(entry);
+}
+
+// Doubles the slots and rehashes; if memory runs out the chains just grow.
+static void
+growSlots(Cache *cache)
+{
+	unsigned int numSlots = 2 * cache->numSlots;
+	CacheEntry **slots = calloc(numSlots, sizeof(CacheEntry *));
+	if (slots == NULL)
+		return;
+	for (unsigned int i = 0; i < cache->numSlots; ++i)
+	{
+		CacheEntry *entry = cache->slots[i];
+		while (entry != NULL)
+		{
+			CacheEntry *next = entry->next;
+			entry->next = slots[entry->hash & (numSlots - 1)];
+			slots[entry->hash & (numSlots - 1)] = entry;
+			entry = next;
+		}
+	}
+	free(cache->slots);
+	cache->slots = slots;
+	cache->numSlots = numSlots;
+}
+
+// Returns the entry for key if it was cached with fingerprint, for the
+// caller to release, or NULL. An entry with another fingerprint is stale
+// and dropped.
+static CacheEntry *
+findCached(Cache *cache, const char *key, Fingerprint *fingerprint)
+{
+	unsigned int hash = hashLabel(key, strlen(key));
+	pthread_mutex_lock(&cache->lock);
+	CacheEntry *entry = lookupEntry(cache, key, hash);
+	if (entry != NULL && memcmp(&entry->fingerprint, fingerprint, sizeof(*fingerprint)))
+	{
+		dropEntry(cache, entry);
+		entry = NULL;
+	}
+	if (entry != NULL)
+	{
+		++entry->refs;
+		unlinkRecent(cache, entry);
+		linkNewest(cache, entry);
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return entry;
+}
+
+// Caches the heap buffer bytes under key, replacing any older entry, and
+// returns the new entry for the caller to release. The cache takes bytes
+// over; NULL is returned, and bytes freed, if memory runs out.
+static CacheEntry *
+storeCached(Cache *cache, const char *key, Fingerprint *fingerprint, char *bytes, size_t size)
+{
+	size_t length = strlen(key);
+	CacheEntry *entry = malloc(sizeof(CacheEntry) + length + 1);
+	if (entry == NULL)
+	{
+		free(bytes);
+		return NULL;
+	}
+	entry->fingerprint = *fingerprint;
+	entry->bytes = bytes;
+	entry->size = size;
+	entry->refs = 2;
+	entry->hash = hashLabel(key, strlen(key));
+	memcpy(entry->key, key, length + 1);
+
+	pthread_mutex_lock(&cache->lock);
+	CacheEntry *old = lookupEntry(cache, key, entry->hash);
+	if (old != NULL)
+		dropEntry(cache, old);
+	if (cache->count == cache->numSlots)
+		growSlots(cache);
+	CacheEntry **slot = &cache->slots[entry->hash & (cache->numSlots - 1)];
+	entry->next = *slot;
+	*slot = entry;
+	linkNewest(cache, entry);
+	cache->size += size;
+	++cache->count;
+	while (cache->size > CACHELIMIT && cache->oldest != entry)
+		dropEntry(cache, cache->oldest);
+	pthread_mutex_unlock(&cache->lock);
+	return entry;
+}
+
+static void
+releaseCached(Cache *cache, CacheEntry *entry)
+{
+	if (entry == NULL)
+		return;
+	pthread_mutex_lock(&cache->lock);
+	bool unused = --entry->refs == 0;
+	pthread_mutex_unlock(&cache->lock);
+	if (unused)
+		freeEntry(entry);
+}
@@ -0,0 +1,809 @@
+/**
+ * Project 2
+ * LC-2K Simulator
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "simulate.h"
+
+typedef struct Override Override;
+typedef struct BatchJob BatchJob;
+typedef struct BatchQueue BatchQueue;
+typedef struct BatchWorker BatchWorker;
+typedef struct Global Global;
+typedef struct ProfileLine ProfileLine;
+
+// A register or memory word a batch job sets once its executable is loaded.
+struct Override
+{
+	bool isRegister;
+	int index;
+	int value;
+};
+
+// One line of a manifest, and how its machine stopped once it has run.
+// loaded is loadMachine's result, or -1 if the executable could not be read.
+struct BatchJob
+{
+	const char *path;
+	int line;
+	uint64_t budget;
+	int firstOverride;
+	int numOverrides;
+	int loaded;
+	enum RunStatus status;
+	uint64_t executed;
+	int pc;
+	int reg[NUMREGS];
+	uint32_t memoryHash;
+};
+
+// Jobs are handed out in order to whichever worker asks next.
+struct BatchQueue
+{
+	BatchJob *jobs;
+	int numJobs;
+	Override *overrides;
+	enum Engine engine;
+	int next;
+	pthread_mutex_t lock;
+};
+
+// Each worker runs its jobs on a machine of its own.
+struct BatchWorker
+{
+	BatchQueue *queue;
+	Machine *machine;
+	pthread_t thread;
+};
+
+// A global label of the executable and the address it names.
+struct Global
+{
+	char *label;
+	int address;
+};
+
+// One line of a profile section: an address, or the addresses from it to
+// last, with its count and, for a beq, how often it was not taken.
+struct ProfileLine
+{
+	uint64_t count;
+	uint64_t other;
+	int address;
+	int last;
+};
+
+static char *readExecutable(const char *path, size_t *size);
+static int readGlobals(const char *reportStr, Global **globals, char **text);
+static void writeProfile(FILE *profileFile, const char *executableStr, Machine *machine, Global *globals,
+						 int numGlobals);
+static bool sameMachine(Machine *machine, enum RunStatus status, Machine *check, enum RunStatus checkStatus);
+static bool parseCount(const char *text, uint64_t *count);
+static int runBatch(const char *manifestStr, enum Engine engine, uint64_t budget);
+
+static const char *engineNames[] = {"reference", "threaded"};
+static const char *statusNames[] = {"halted", "budget", "bad-pc", "bad-address"};
+
+int main(int argc, char *argv[])
+{
+	char *program = argv[0];
+	bool quiet = false;
+	bool compare = false;
+	bool batch = false;
+	enum Engine engine = ENGINE_THREADED;
+	uint64_t budget = NOBUDGET;
+	char *profileFileStr = NULL;
+	char *reportFileStr = NULL;
+
+	// -q prints only the final state rather than the state before every
+	// instruction, so long runs go at full speed. -e picks the engine, and -c
+	// runs the other one alongside it and fails if they ever disagree. -p
+	// writes a profile of the run, naming addresses by the globals of the
+	// linker's -r report given with -l. -m runs every executable a manifest
+	// lists, each for at most -n instructions unless its line says otherwise.
+	bool usage = false;
+	for (; argc > 1 && argv[1][0] == '-' && !usage; --argc, ++argv)
+	{
+		if (!strcmp(argv[1], "-q"))
+			quiet = true;
+		else if (!strcmp(argv[1], "-c"))
+			compare = true;
+		else if (!strcmp(argv[1], "-m"))
+			batch = true;
+		else if (!strcmp(argv[1], "-e") && argc > 2 && !strcmp(argv[2], engineNames[ENGINE_REFERENCE]))
+		{
+			engine = ENGINE_REFERENCE;
+			--argc;
+			++argv;
+		}
+		else if (!strcmp(argv[1], "-e") && argc > 2 && !strcmp(argv[2], engineNames[ENGINE_THREADED]))
+		{
+			engine = ENGINE_THREADED;
+			--argc;
+			++argv;
+		}
+		else if (!strcmp(argv[1], "-n") && argc > 2 && parseCount(argv[2], &budget))
+		{
+			--argc;
+			++argv;
+		}
+		else if (!strcmp(argv[1], "-p") && argc > 2)
+		{
+			profileFileStr = argv[2];
+			--argc;
+			++argv;
+		}
+		else if (!strcmp(argv[1], "-l") && argc > 2)
+		{
+			reportFileStr = argv[2];
+			--argc;
+			++argv;
+		}
+		else
+			usage = true;
+	}
+
+	// only the threaded engine profiles
+	bool profiling = profileFileStr != NULL;
+	if (argc != 2 || usage || (batch && (quiet || compare || profiling)) || (!batch && budget != NOBUDGET) ||
+		(profiling && engine != ENGINE_THREADED) || (reportFileStr != NULL && !profiling))
+	{
+		printf("error: usage: %s [-q] [-c] [-e reference|threaded] [-p <profile-file> [-l <link-report>]]\n"
+			   "       %*s <machine-code-file>\n"
+			   "       %s -m [-e reference|threaded] [-n <instructions>] <manifest-file>\n",
+			   program, (int)strlen(program), "", program);
+		exit(1);
+	}
+	if (batch)
+		return runBatch(argv[1], engine, budget);
+
+	size_t size;
+	char *text = readExecutable(argv[1], &size);
+	if (text == NULL)
+	{
+		printf("error in opening %s\n", argv[1]);
+		exit(1);
+	}
+	Machine *machine = malloc(sizeof(Machine));
+	if (machine == NULL)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	int line = loadMachine(machine, text, size);
+	free(text);
+	if (line > MEMORYSIZE)
+	{
+		printf("error: %s does not fit in memory\n", argv[1]);
+		exit(1);
+	}
+	if (line != 0)
+	{
+		printf("error in reading address %d\n", line - 1);
+		exit(1);
+	}
+	Machine *check = NULL;
+	enum Engine checkEngine = engine == ENGINE_THREADED ? ENGINE_REFERENCE : ENGINE_THREADED;
+	enum RunStatus checkStatus = RUN_BUDGET;
+	if (compare)
+	{
+		check = malloc(sizeof(Machine));
+		if (check == NULL)
+		{
+			printf("error: out of memory\n");
+			exit(1);
+		}
+		memcpy(check, machine, sizeof(Machine));
+	}
+	FILE *profileFile = NULL;
+	Global *globals = NULL;
+	char *report = NULL;
+	int numGlobals = 0;
+	if (profiling)
+	{
+		if (reportFileStr != NULL && (numGlobals = readGlobals(reportFileStr, &globals, &report)) < 0)
+		{
+			printf("error in reading %s\n", reportFileStr);
+			exit(1);
+		}
+		profileFile = fopen(profileFileStr, "w");
+		if (profileFile == NULL)
+		{
+			printf("error in opening %s\n", profileFileStr);
+			exit(1);
+		}
+		machine->profile = calloc(1, sizeof(Profile));
+		if (machine->profile == NULL)
+		{
+			printf("error: out of memory\n");
+			exit(1);
+		}
+	}
+
+	static char buffer[1 << 20];
+	setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+	enum RunStatus status;
+	if (quiet)
+	{
+		status = runMachine(machine, engine, NOBUDGET);
+		if (check != NULL)
+			checkStatus = runMachine(check, checkEngine, NOBUDGET);
+	}
+	else
+	{
+		for (int i = 0; i < machine->numMemory; ++i)
+			printf("memory[%d]=0x%08X\n", i, machine->mem[i]);
+		do
+		{
+			printState(stdout, machine);
+			status = runMachine(machine, engine, 1);
+			if (check != NULL)
+			{
+				checkStatus = runMachine(check, checkEngine, 1);
+				if (!sameMachine(machine, status, check, checkStatus))
+					break;
+			}
+		} while (status == RUN_BUDGET);
+	}
+	if (check != NULL && !sameMachine(machine, status, check, checkStatus))
+	{
+		printf("error: the %s and %s engines disagree after %" PRIu64 " instructions\n", engineNames[engine],
+			   engineNames[checkEngine], machine->numInstructionsExecuted);
+		exit(1);
+	}
+	free(check);
+
+	// a run that faulted is profiled too
+	if (profiling)
+	{
+		writeProfile(profileFile, argv[1], machine, globals, numGlobals);
+		if (fclose(profileFile) != 0)
+		{
+			printf("error in writing %s\n", profileFileStr);
+			exit(1);
+		}
+		free(machine->profile);
+		free(globals);
+		free(report);
+	}
+
+	if (status == RUN_BAD_PC)
+	{
+		printf("error: pc %d is outside memory\n", machine->pc);
+		exit(1);
+	}
+	if (status == RUN_BAD_ADDRESS)
+	{
+		Decoded *inst = &machine->code[machine->pc];
+		printf("error: %s at pc %d addresses %d, outside memory\n", inst->opcode == OP_LW ? "lw" : "sw",
+			   machine->pc, (int)((unsigned int)machine->reg[inst->regA] + (unsigned int)inst->offset));
+		exit(1);
+	}
+	printf("machine halted\n");
+	printf("total of %" PRIu64 " instructions executed\n", machine->numInstructionsExecuted);
+	printf("final state of machine:\n");
+	printState(stdout, machine);
+	free(machine);
+	return 0;
+
+} // main
+
+// Whether two machines that ran the same executable stopped the same way in
+// the same state.
+static bool
+sameMachine(Machine *machine, enum RunStatus status, Machine *check, enum RunStatus checkStatus)
+{
+	return status == checkStatus && machine->pc == check->pc &&
+		   machine->numInstructionsExecuted == check->numInstructionsExecuted &&
+		   !memcmp(machine->reg, check->reg, sizeof(machine->reg)) &&
+		   !memcmp(machine->mem, check->mem, sizeof(machine->mem));
+}
+
+// Parses a count of instructions, in decimal or hex after "0x".
+static bool
+parseCount(const char *text, uint64_t *count)
+{
+	char *end;
+	errno = 0;
+	unsigned long long value = strtoull(text, &end, 0);
+	if (*text < '0' || *text > '9' || *end != '\0' || errno != 0)
+		return false;
+	*count = value;
+	return true;
+}
+
+// Parses a 32-bit word, signed or not, into *word.
+static bool
+parseValue(const char *text, int *word)
+{
+	char *end;
+	errno = 0;
+	long long value = strtoll(text, &end, 0);
+	if (end == text || *end != '\0' || errno != 0 || value < INT32_MIN || value > UINT32_MAX)
+		return false;
+	*word = (int)(uint32_t)value;
+	return true;
+}
+
+// Parses one setting after the executable on a manifest line:
+// budget=<instructions>, reg[<register>]=<word> or mem[<address>]=<word>.
+// Returns 1 for a register or memory word, stored in *override, 0 for a
+// budget, stored in the job, and -1 if the setting is none of them.
+static int
+parseSetting(const char *setting, BatchJob *job, Override *override)
+{
+	if (!strncmp(setting, "budget=", 7))
+		return parseCount(setting + 7, &job->budget) ? 0 : -1;
+
+	override->isRegister = !strncmp(setting, "reg[", 4);
+	if (!override->isRegister && strncmp(setting, "mem[", 4))
+		return -1;
+	char *end;
+	errno = 0;
+	long index = strtol(setting + 4, &end, 0);
+	int limit = override->isRegister ? NUMREGS : MEMORYSIZE;
+	if (setting[4] < '0' || setting[4] > '9' || end[0] != ']' || end[1] != '=' || errno != 0 || index >= limit)
+		return -1;
+	override->index = index;
+	return parseValue(end + 2, &override->value) ? 1 : -1;
+}
+
+// Reads a manifest: one job per line, an executable followed by any settings
+// for it, separated by spaces. Blank lines and lines starting with # are
+// skipped. Returns the manifest's text, which the jobs' paths point into.
+// Exits with a message if the manifest cannot be read or a setting is bad.
+static char *
+readManifest(const char *manifestStr, uint64_t budget, BatchJob **jobs, int *numJobs, Override **overrides)
+{
+	size_t size;
+	char *text = readExecutable(manifestStr, &size);
+	if (text == NULL)
+	{
+		printf("error in opening %s\n", manifestStr);
+		exit(1);
+	}
+
+	int jobCapacity = 0;
+	int overrideCapacity = 0;
+	int numOverrides = 0;
+	*jobs = NULL;
+	*numJobs = 0;
+	*overrides = NULL;
+	int lineNumber = 0;
+	for (char *line = text; line < text + size;)
+	{
+		char *next = memchr(line, '\n', text + size - line);
+		next = next == NULL ? text + size : next;
+		*next = '\0';
+		++lineNumber;
+		char *save;
+		char *word = strtok_r(line, " \t\r", &save);
+		line = next + 1;
+		if (word == NULL || word[0] == '#')
+			continue;
+
+		if (*numJobs == jobCapacity)
+		{
+			jobCapacity = jobCapacity ? jobCapacity * 2 : 256;
+			*jobs = realloc(*jobs, jobCapacity * sizeof(BatchJob));
+		}
+		if (*jobs == NULL)
+		{
+			printf("error: out of memory\n");
+			exit(1);
+		}
+		BatchJob *job = &(*jobs)[(*numJobs)++];
+		memset(job, 0, sizeof(BatchJob));
+		job->path = word;
+		job->line = lineNumber;
+		job->budget = budget;
+		job->firstOverride = numOverrides;
+		while ((word = strtok_r(NULL, " \t\r", &save)) != NULL)
+		{
+			if (numOverrides == overrideCapacity)
+			{
+				overrideCapacity = overrideCapacity ? overrideCapacity * 2 : 256;
+				*overrides = realloc(*overrides, overrideCapacity * sizeof(Override));
+			}
+			if (*overrides == NULL)
+			{
+				printf("error: out of memory\n");
+				exit(1);
+			}
+			int parsed = parseSetting(word, job, &(*overrides)[numOverrides]);
+			if (parsed < 0)
+			{
+				printf("error: bad setting %s on line %d of %s\n", word, lineNumber, manifestStr);
+				exit(1);
+			}
+			numOverrides += parsed;
+		}
+		job->numOverrides = numOverrides - job->firstOverride;
+	}
+	return text;
+}
+
+// Loads and runs one job on machine, keeping how it stopped. The memory hash
+// is FNV-1a over the loaded words, the ones the final state prints.
+static void
+runJob(BatchQueue *queue, BatchJob *job, Machine *machine)
+{
+	size_t size;
+	char *text = readExecutable(job->path, &size);
+	if (text == NULL)
+	{
+		job->loaded = -1;
+		return;
+	}
+	job->loaded = loadMachine(machine, text, size);
+	free(text);
+	if (job->loaded != 0)
+		return;
+
+	for (int i = 0; i < job->numOverrides; ++i)
+	{
+		Override *override = &queue->overrides[job->firstOverride + i];
+		if (override->isRegister)
+			machine->reg[override->index] = override->value;
+		else
+			storeWord(machine, override->index, override->value);
+	}
+	job->status = runMachine(machine, queue->engine, job->budget);
+	job->executed = machine->numInstructionsExecuted;
+	job->pc = machine->pc;
+	memcpy(job->reg, machine->reg, sizeof(job->reg));
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < machine->numMemory; ++i)
+		hash = (hash ^ (uint32_t)machine->mem[i]) * 16777619u;
+	job->memoryHash = hash;
+}
+
+static void *
+batchWorker(void *arg)
+{
+	BatchWorker *worker = arg;
+	BatchQueue *queue = worker->queue;
+	for (;;)
+	{
+		pthread_mutex_lock(&queue->lock);
+		int next = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+		if (next >= queue->numJobs)
+			return NULL;
+		runJob(queue, &queue->jobs[next], worker->machine);
+	}
+}
+
+// Runs every job of a manifest on a pool of one worker per online CPU, the
+// calling thread included, then prints one line per job in manifest order:
+//   <line> <executable> <status> <instructions> <pc> <reg 0>...<reg 7> <memory hash>
+// where status is halted, budget, bad-pc or bad-address. An executable that
+// cannot be run gets only unopened, unreadable <address> or oversized after
+// its name. Returns 0 if every job halted, 1 otherwise.
+static int
+runBatch(const char *manifestStr, enum Engine engine, uint64_t budget)
+{
+	BatchQueue queue;
+	char *text = readManifest(manifestStr, budget, &queue.jobs, &queue.numJobs, &queue.overrides);
+	queue.engine = engine;
+	queue.next = 0;
+	pthread_mutex_init(&queue.lock, NULL);
+
+	long numWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (numWorkers > queue.numJobs)
+		numWorkers = queue.numJobs;
+	if (numWorkers < 1)
+		numWorkers = 1;
+	BatchWorker *workers = malloc(numWorkers * sizeof(BatchWorker));
+	// a worker without a machine or a thread leaves its share to the others
+	long started = 0;
+	while (workers != NULL && started < numWorkers)
+	{
+		workers[started].queue = &queue;
+		workers[started].machine = malloc(sizeof(Machine));
+		if (workers[started].machine == NULL)
+			break;
+		if (started > 0 && pthread_create(&workers[started].thread, NULL, batchWorker, &workers[started]) != 0)
+		{
+			free(workers[started].machine);
+			break;
+		}
+		++started;
+	}
+	if (started == 0)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	batchWorker(&workers[0]);
+	for (long i = 0; i < started; ++i)
+	{
+		if (i > 0)
+			pthread_join(workers[i].thread, NULL);
+		free(workers[i].machine);
+	}
+	free(workers);
+	pthread_mutex_destroy(&queue.lock);
+
+	static char buffer[1 << 20];
+	setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+	int status = 0;
+	for (int i = 0; i < queue.numJobs; ++i)
+	{
+		BatchJob *job = &queue.jobs[i];
+		printf("%d %s ", job->line, job->path);
+		if (job->loaded < 0)
+			printf("unopened\n");
+		else if (job->loaded > MEMORYSIZE)
+			printf("oversized\n");
+		else if (job->loaded > 0)
+			printf("unreadable %d\n", job->loaded - 1);
+		else
+		{
+			printf("%s %" PRIu64 " %d", statusNames[job->status], job->executed, job->pc);
+			for (int r = 0; r < NUMREGS; ++r)
+				printf(" %d", job->reg[r]);
+			printf(" %08X\n", job->memoryHash);
+		}
+		if (job->loaded != 0 || job->status != RUN_HALTED)
+			status = 1;
+	}
+	free(queue.jobs);
+	free(queue.overrides);
+	free(text);
+	return status;
+}
+
+// By address, for looking up the global an address is in.
+static int
+compareGlobals(const void *a, const void *b)
+{
+	return ((const Global *)a)->address - ((const Global *)b)->address;
+}
+
+// Parses an address field of a link report, which a comma ends.
+static bool
+parseAddress(const char *text, int *address)
+{
+	char *end;
+	errno = 0;
+	long value = strtol(text, &end, 10);
+	if (*text < '0' || *text > '9' || *end != ',' || errno != 0 || value > MEMORYSIZE)
+		return false;
+	*address = (int)value;
+	return true;
+}
+
+// Reads the globals of a report the linker wrote with -r, and Stack where
+// the report puts it, into *globals sorted by address. Returns how many
+// there are, Stack included, or -1 if the report cannot be read or is cut
+// short. The labels point into *text, the report's.
+static int
+readGlobals(const char *reportStr, Global **globals, char **text)
+{
+	size_t size;
+	*text = readExecutable(reportStr, &size);
+	if (*text == NULL)
+		return -1;
+	char *list = strstr(*text, "\"globals\": [");
+	char *stack = strstr(*text, "\"stack\": ");
+	char *end = list != NULL ? strchr(list, ']') : NULL;
+	if (list == NULL || stack == NULL || end == NULL)
+		return -1;
+
+	// the report is written one global per line, and labels need no escapes
+	int capacity = 64;
+	int count = 0;
+	*globals = malloc(capacity * sizeof(Global));
+	if (*globals == NULL)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	(*globals)[count].label = "Stack";
+	if (!parseAddress(stack + strlen("\"stack\": "), &(*globals)[count++].address))
+	{
+		free(*globals);
+		return -1;
+	}
+	for (char *entry = strstr(list, "{\"label\": \""); entry != NULL && entry < end;
+		 entry = strstr(entry, "{\"label\": \""))
+	{
+		entry += strlen("{\"label\": \"");
+		char *quote = strchr(entry, '"');
+		char *address = quote != NULL ? strstr(quote, "\"address\": ") : NULL;
+		if (address == NULL || address > end)
+		{
+			free(*globals);
+			return -1;
+		}
+		if (count == capacity)
+		{
+			capacity *= 2;
+			*globals = realloc(*globals, capacity * sizeof(Global));
+			if (*globals == NULL)
+			{
+				printf("error: out of memory\n");
+				exit(1);
+			}
+		}
+		if (!parseAddress(address + strlen("\"address\": "), &(*globals)[count].address))
+		{
+			free(*globals);
+			return -1;
+		}
+		*quote = '\0';
+		(*globals)[count++].label = entry;
+		entry = quote + 1;
+	}
+	qsort(*globals, count, sizeof(Global), compareGlobals);
+	return count;
+}
+
+// Prints address as the nearest global at or below it plus an offset.
+static void
+printWhere(FILE *stream, int address, Global *globals, int numGlobals)
+{
+	int low = 0;
+	int high = numGlobals;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (globals[middle].address <= address)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low == 0)
+		fprintf(stream, "-\n");
+	else if (globals[low - 1].address == address)
+		fprintf(stream, "%s\n", globals[low - 1].label);
+	else
+		fprintf(stream, "%s+%d\n", globals[low - 1].label, address - globals[low - 1].address);
+}
+
+// Most executed first, then by address.
+static int
+compareLines(const void *a, const void *b)
+{
+	const ProfileLine *lineA = a;
+	const ProfileLine *lineB = b;
+	if (lineA->count != lineB->count)
+		return lineA->count < lineB->count ? 1 : -1;
+	return lineA->address - lineB->address;
+}
+
+// Writes the machine's profile in four sections, each sorted by its first
+// column, most first: the instructions each address executed, the times
+// each basic block ran, the jumps by jalr (calls and returns alike) to each
+// address, and how often each beq was taken and not. Every line ends with
+// its address as a label.
+static void
+writeProfile(FILE *profileFile, const char *executableStr, Machine *machine, Global *globals, int numGlobals)
+{
+	Profile *profile = machine->profile;
+	uint64_t *executed = malloc(MEMORYSIZE * sizeof(uint64_t));
+	ProfileLine *lines = malloc(MEMORYSIZE * sizeof(ProfileLine));
+	if (executed == NULL || lines == NULL)
+	{
+		printf("error: out of memory\n");
+		exit(1);
+	}
+	countExecutions(profile, executed);
+	fprintf(profileFile, "# %s: %" PRIu64 " instructions executed\n", executableStr,
+			machine->numInstructionsExecuted);
+
+	int numLines = 0;
+	for (int i = 0; i < MEMORYSIZE; ++i)
+	{
+		if (executed[i] != 0)
+			lines[numLines++] = (ProfileLine){executed[i], 0, i, i};
+	}
+	qsort(lines, numLines, sizeof(ProfileLine), compareLines);
+	fprintf(profileFile, "# instructions: count address where\n");
+	for (int i = 0; i < numLines; ++i)
+	{
+		fprintf(profileFile, "%12" PRIu64 " %5d ", lines[i].count, lines[i].address);
+		printWhere(profileFile, lines[i].address, globals, numGlobals);
+	}
+
+	// A block goes on until control may leave it or enter it other than in
+	// order, judged by the words as they ended up and the run's counts.
+	numLines = 0;
+	for (int i = 0; i < MEMORYSIZE; ++i)
+	{
+		if (executed[i] == 0)
+			continue;
+		int opcode = i > 0 ? machine->code[i - 1].opcode : OP_HALT;
+		bool leader = i == 0 || profile->entries[i] != 0 || profile->exits[i - 1] != 0 ||
+					  executed[i - 1] != executed[i] || opcode == OP_BEQ || opcode == OP_JALR || opcode == OP_HALT;
+		if (leader)
+			lines[numLines++] = (ProfileLine){executed[i], 0, i, i};
+		else
+			lines[numLines - 1].last = i;
+	}
+	qsort(lines, numLines, sizeof(ProfileLine), compareLines);
+	fprintf(profileFile, "# basic blocks: count first-last where\n");
+	for (int i = 0; i < numLines; ++i)
+	{
+		fprintf(profileFile, "%12" PRIu64 " %5d-%-5d ", lines[i].count, lines[i].address, lines[i].last);
+		printWhere(profileFile, lines[i].address, globals, numGlobals);
+	}
+
+	numLines = 0;
+	for (int i = 0; i < MEMORYSIZE; ++i)
+	{
+		if (profile->calls[i] != 0)
+			lines[numLines++] = (ProfileLine){profile->calls[i], 0, i, i};
+	}
+	qsort(lines, numLines, sizeof(ProfileLine), compareLines);
+	fprintf(profileFile, "# jalr targets: count address where\n");
+	for (int i = 0; i < numLines; ++i)
+	{
+		fprintf(profileFile, "%12" PRIu64 " %5d ", lines[i].count, lines[i].address);
+		printWhere(profileFile, lines[i].address, globals, numGlobals);
+	}
+
+	// a beq exits its word exactly when it is taken
+	numLines = 0;
+	for (int i = 0; i < MEMORYSIZE; ++i)
+	{
+		if (executed[i] != 0 && machine->code[i].opcode == OP_BEQ)
+			lines[numLines++] = (ProfileLine){profile->exits[i], executed[i] - profile->exits[i], i, i};
+	}
+	qsort(lines, numLines, sizeof(ProfileLine), compareLines);
+	fprintf(profileFile, "# beq outcomes: taken not-taken address where\n");
+	for (int i = 0; i < numLines; ++i)
+	{
+		fprintf(profileFile, "%12" PRIu64 " %12" PRIu64 " %5d ", lines[i].count, lines[i].other, lines[i].address);
+		printWhere(profileFile, lines[i].address, globals, numGlobals);
+	}
+	free(executed);
+	free(lines);
+}
+
+// Reads the whole file at path into a NUL-terminated heap buffer, or
+// returns NULL.
+static char *
+readExecutable(const char *path, size_t *size)
+{
+	FILE *inFilePtr = fopen(path, "rb");
+	if (inFilePtr == NULL)
+		return NULL;
+	size_t capacity = 1 << 16;
+	size_t length = 0;
+	char *text = malloc(capacity + 1);
+	while (text != NULL)
+	{
+		length += fread(text + length, 1, capacity - length, inFilePtr);
+		if (length < capacity)
+			break;
+		capacity *= 2;
+		char *grown = realloc(text, capacity + 1);
+		if (grown == NULL)
+			free(text);
+		text = grown;
+	}
+	bool failed = ferror(inFilePtr);
+	fclose(inFilePtr);
+	if (failed || text == NULL)
+	{
+		free(text);
+		return NULL;
+	}
+	text[length] = '\0';
+	*size = length;
+	return text;
+}
@@ -0,0 +1,188 @@
+/**
+ * Project 2
+ * LC-2K object archives (libraries), written by the archiver and searched by
+ * the linker
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive.h"
+
+bool isArchiveFile(const char *path)
+{
+    FILE *inFilePtr = fopen(path, "rb");
+    if (inFilePtr == NULL)
+        return false;
+    char magic[ARCHIVEMAGICSIZE];
+    bool archive = fread(magic, 1, ARCHIVEMAGICSIZE, inFilePtr) == ARCHIVEMAGICSIZE &&
+                   !memcmp(magic, ARCHIVEMAGIC, ARCHIVEMAGICSIZE);
+    fclose(inFilePtr);
+    return archive;
+}
+
+bool isArchiveBuffer(const char *buffer, size_t size)
+{
+    return size >= ARCHIVEMAGICSIZE && !memcmp(buffer, ARCHIVEMAGIC, ARCHIVEMAGICSIZE);
+}
+
+// Checks the index against the file and builds the member and symbol tables
+// and the hash of the symbols.
+static int
+parseArchive(Archive *archive)
+{
+    const char *buffer = archive->buffer;
+    size_t size = archive->bufferSize;
+    if (size < ARCHIVEHEADERSIZE || memcmp(buffer, ARCHIVEMAGIC, ARCHIVEMAGICSIZE) ||
+        loadWord(buffer + 8) != ARCHIVEVERSION)
+        return -2;
+    uint32_t memberCount = loadWord(buffer + 12);
+    uint32_t symbolCount = loadWord(buffer + 16);
+    uint32_t stringTableSize = loadWord(buffer + 20);
+    if (memberCount > INT32_MAX || symbolCount > INT32_MAX)
+        return -2;
+    size_t indexSize = ARCHIVEHEADERSIZE + (size_t)ARCHIVEMEMBERSIZE * memberCount +
+                       (size_t)ARCHIVESYMBOLSIZE * symbolCount + stringTableSize;
+    if (indexSize > size)
+        return -2;
+
+    // every name and label must end inside the string table
+    const char *strings = buffer + indexSize - stringTableSize;
+    if (memberCount + symbolCount && (stringTableSize == 0 || strings[stringTableSize - 1] != '\0'))
+        return -2;
+
+    archive->memberCount = memberCount;
+    archive->symbolCount = symbolCount;
+    archive->numSlots = 16;
+    while (archive->numSlots < 2 * symbolCount)
+        archive->numSlots *= 2;
+    archive->members = malloc((memberCount + 1) * sizeof(ArchiveMember));
+    archive->symbols = malloc((symbolCount + 1) * sizeof(ArchiveSymbol));
+    archive->slots = calloc(archive->numSlots, sizeof(int));
+    if (archive->members == NULL || archive->symbols == NULL || archive->slots == NULL)
+        return -3;
+
+    const char *ptr = buffer + ARCHIVEHEADERSIZE;
+    for (int i = 0; i < archive->memberCount; ++i, ptr += ARCHIVEMEMBERSIZE)
+    {
+        uint32_t name = loadWord(ptr);
+        uint32_t offset = loadWord(ptr + 4);
+        uint32_t length = loadWord(ptr + 8);
+        if (name >= stringTableSize || offset < indexSize || offset > size || length > size - offset)
+            return -2;
+        archive->members[i].name = strings + name;
+        archive->members[i].bytes = buffer + offset;
+        archive->members[i].size = length;
+    }
+
+    for (int i = 0; i < archive->symbolCount; ++i, ptr += ARCHIVESYMBOLSIZE)
+    {
+        uint32_t label = loadWord(ptr);
+        uint32_t member = loadWord(ptr + 4);
+        if (label >= stringTableSize || member >= memberCount)
+            return -2;
+        archive->symbols[i].label = strings + label;
+        archive->symbols[i].member = member;
+        size_t length = strlen(strings + label);
+
+        // a label indexed twice keeps its first member
+        if (findArchiveSymbol(archive, archive->symbols[i].label) >= 0)
+            continue;
+        unsigned int slot = hashLabel(archive->symbols[i].label, length) & (archive->numSlots - 1);
+        while (archive->slots[slot])
+            slot = (slot + 1) & (archive->numSlots - 1);
+        archive->slots[slot] = i + 1;
+    }
+    return 0;
+}
+
+int readArchive(const char *path, Archive *archive)
+{
+    memset(archive, 0, sizeof(*archive));
+    if (loadFile(path, &archive->buffer, &archive->bufferSize, &archive->mapped) != 0)
+        return -1;
+    int result = parseArchive(archive);
+    if (result != 0)
+        freeArchive(archive);
+    return result;
+}
+
+int readArchiveBuffer(const char *buffer, size_t size, Archive *archive)
+{
+    memset(archive, 0, sizeof(*archive));
+    archive->buffer = buffer;
+    archive->bufferSize = size;
+    int result = parseArchive(archive);
+    // the buffer stays the caller's
+    archive->buffer = NULL;
+    if (result != 0)
+        freeArchive(archive);
+    return result;
+}
+
+int findArchiveSymbol(Archive *archive, const char *label)
+{
+    unsigned int slot = hashLabel(label, strlen(label)) & (archive->numSlots - 1);
+    while (archive->slots[slot])
+    {
+        ArchiveSymbol *symbol = &archive->symbols[archive->slots[slot] - 1];
+        if (!strcmp(symbol->label, label))
+            return symbol->member;
+        slot = (slot + 1) & (archive->numSlots - 1);
+    }
+    return -1;
+}
+
+void freeArchive(Archive *archive)
+{
+    if (archive->buffer != NULL)
+        unloadFile(archive->buffer, archive->bufferSize, archive->mapped);
+    free(archive->members);
+    free(archive->symbols);
+    free(archive->slots);
+    memset(archive, 0, sizeof(*archive));
+}
+
+void writeArchive(OutputBuffer *out, ArchiveMember *members, int memberCount, ArchiveSymbol *symbols,
+                  int symbolCount)
+{
+    size_t stringTableSize = 0;
+    for (int i = 0; i < memberCount; ++i)
+        stringTableSize += strlen(members[i].name) + 1;
+    for (int i = 0; i < symbolCount; ++i)
+        stringTableSize += strlen(symbols[i].label) + 1;
+
+    writeBytes(out, ARCHIVEMAGIC, ARCHIVEMAGICSIZE);
+    writeWord(out, ARCHIVEVERSION);
+    writeWord(out, memberCount);
+    writeWord(out, symbolCount);
+    writeWord(out, stringTableSize);
+
+    // strings are laid out in the order they are referenced: names, then labels
+    uint32_t string = 0;
+    size_t offset = ARCHIVEHEADERSIZE + (size_t)ARCHIVEMEMBERSIZE * memberCount +
+                    (size_t)ARCHIVESYMBOLSIZE * symbolCount + stringTableSize;
+    for (int i = 0; i < memberCount; ++i)
+    {
+        writeWord(out, string);
+        writeWord(out, offset);
+        writeWord(out, members[i].size);
+        string += strlen(members[i].name) + 1;
+        offset += members[i].size;
+    }
+    for (int i = 0; i < symbolCount; ++i)
+    {
+        writeWord(out, string);
+        writeWord(out, symbols[i].member);
+        string += strlen(symbols[i].label) + 1;
+    }
+
+    for (int i = 0; i < memberCount; ++i)
+        writeBytes(out, members[i].name, strlen(members[i].name) + 1);
+    for (int i = 0; i < symbolCount; ++i)
+        writeBytes(out, symbols[i].label, strlen(symbols[i].label) + 1);
+    for (int i = 0; i < memberCount; ++i)
+        writeBytes(out, members[i].bytes, members[i].size);
+}
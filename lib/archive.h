@@ -0,0 +1,96 @@
+/**
+ * Project 2
+ * LC-2K object archives (libraries), written by the archiver and searched by
+ * the linker
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "object.h"
+#include "outbuf.h"
+
+/*
+ * An archive packs object files of either format, byte for byte, behind an
+ * index of the global symbols they define. All fields are little-endian:
+ *     char     magic[8]            "LC2KLIB\0"
+ *     uint32   version             ARCHIVEVERSION
+ *     uint32   memberCount, symbolCount, stringTableSize
+ *     members  { uint32 name; uint32 offset; uint32 size; }
+ *     symbols  { uint32 label; uint32 member; }
+ *     char     strings[stringTableSize]
+ *     char     member bytes
+ * name and label are offsets of NUL-terminated strings in the string table;
+ * offset locates a member's bytes from the start of the archive.
+ */
+#define ARCHIVEMAGIC "LC2KLIB"
+#define ARCHIVEMAGICSIZE 8
+#define ARCHIVEVERSION 1
+#define ARCHIVEHEADERSIZE 24
+#define ARCHIVEMEMBERSIZE 12
+#define ARCHIVESYMBOLSIZE 8
+
+typedef struct Archive Archive;
+typedef struct ArchiveMember ArchiveMember;
+typedef struct ArchiveSymbol ArchiveSymbol;
+
+struct ArchiveMember
+{
+    const char *name;
+    const char *bytes;
+    size_t size;
+};
+
+// A global label and the index of the member that defines it.
+struct ArchiveSymbol
+{
+    const char *label;
+    int member;
+};
+
+// An archive in memory. Only the index is parsed; members are left as bytes
+// for the linker to parse when it pulls them in. slots hash the symbols,
+// holding 1 + index or 0 for empty, and numSlots is a power of two. buffer
+// is NULL if the bytes belong to the caller of readArchiveBuffer.
+struct Archive
+{
+    int memberCount;
+    int symbolCount;
+    ArchiveMember *members;
+    ArchiveSymbol *symbols;
+    int *slots;
+    unsigned int numSlots;
+    const char *buffer;
+    size_t bufferSize;
+    bool mapped;
+};
+
+// Returns whether the file at path starts with the archive magic.
+bool isArchiveFile(const char *path);
+
+// Returns whether the size bytes at buffer start with the archive magic.
+bool isArchiveBuffer(const char *buffer, size_t size);
+
+// Reads the index of the archive at path. Returns 0 on success, -1 if the
+// file cannot be opened, -2 if it is not a well-formed archive and -3 if
+// memory ran out.
+int readArchive(const char *path, Archive *archive);
+
+// Reads the index of an archive already in memory. The buffer is not copied
+// and must outlive archive. Returns 0 on success, -2 if it is malformed and
+// -3 if memory ran out.
+int readArchiveBuffer(const char *buffer, size_t size, Archive *archive);
+
+// Returns the member that defines label, or -1 if none does.
+int findArchiveSymbol(Archive *archive, const char *label);
+
+void freeArchive(Archive *archive);
+
+// Writes an archive of the given members and index to out.
+void writeArchive(OutputBuffer *out, ArchiveMember *members, int memberCount, ArchiveSymbol *symbols,
+                  int symbolCount);
+
+#endif
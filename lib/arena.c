@@ -0,0 +1,61 @@
+/**
+ * Project 2
+ * Bump allocator shared by the LC-2K assembler and linker
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+    ArenaBlock *block = arena->head;
+    if (block != NULL && block->size - block->used >= size)
+    {
+        void *result = block->data + block->used;
+        block->used += size;
+        return result;
+    }
+
+    // a request bigger than a block gets a block of its own, kept behind the
+    // head so that what is left of the head still gets used
+    size_t blockSize = size > ARENABLOCKSIZE ? size : ARENABLOCKSIZE;
+    block = malloc(sizeof(ArenaBlock) + blockSize);
+    if (block == NULL)
+        return NULL;
+    block->size = blockSize;
+    block->used = size;
+    if (size > ARENABLOCKSIZE && arena->head != NULL)
+    {
+        block->next = arena->head->next;
+        arena->head->next = block;
+    }
+    else
+    {
+        block->next = arena->head;
+        arena->head = block;
+    }
+    return block->data;
+}
+
+char *arenaString(Arena *arena, const char *string, size_t length)
+{
+    char *copy = arenaAlloc(arena, length + 1);
+    if (copy == NULL)
+        return NULL;
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arenaFree(Arena *arena)
+{
+    while (arena->head != NULL)
+    {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * Project 2
+ * Bump allocator shared by the LC-2K assembler and linker
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Arena blocks are at least this large; bigger requests get their own block.
+#define ARENABLOCKSIZE (1 << 20)
+
+typedef struct Arena Arena;
+typedef struct ArenaBlock ArenaBlock;
+
+// Everything allocated from an arena is released at once by arenaFree.
+// A zeroed Arena is empty and ready for use. The header is three words, so
+// data is 8-byte aligned in a block from malloc.
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct Arena
+{
+    ArenaBlock *head;
+};
+
+// Returns size bytes from the arena, aligned to 8 bytes: enough for the
+// ints, pointers and 64-bit counts the tables hold, not for long double.
+// Returns NULL if memory ran out; the arena is left as it was.
+void *arenaAlloc(Arena *arena, size_t size);
+
+// Returns a NUL-terminated copy of the first length bytes of string, or
+// NULL if memory ran out.
+char *arenaString(Arena *arena, const char *string, size_t length);
+
+void arenaFree(Arena *arena);
+
+#endif
@@ -0,0 +1,838 @@
+/**
+ * Project 2
+ * LC-2K assembler, as a library the assembler command and server share
+ */
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "assemble.h"
+#include "object.h"
+
+// Initial capacity of the growable tables; they double whenever they fill up.
+#define INITIALTABLESIZE 64
+
+typedef struct Token Token;
+typedef struct OpcodeInfo OpcodeInfo;
+typedef struct Instruction Instruction;
+
+// One field of a source line, as a slice of the source buffer. Numbers are
+// converted once by the tokenizer: value is what atoi would return.
+struct Token
+{
+    const char *start;
+    int length;
+    int value;     // numeric value if isNumber
+    int reg;       // register number, -1 if the field is not a valid register
+    bool isNumber; // the whole field is a decimal integer
+};
+
+// Instruction formats. .fill is its own format since it is a data word.
+enum Format
+{
+    FORMAT_R,
+    FORMAT_I,
+    FORMAT_J,
+    FORMAT_O,
+    FORMAT_FILL
+};
+
+// What each of arg0, arg1, arg2 holds and where it goes in the word.
+enum Operand
+{
+    OPERAND_NONE,
+    OPERAND_REGA,   // register in bits 21-19
+    OPERAND_REGB,   // register in bits 18-16
+    OPERAND_DEST,   // register in bits 2-0
+    OPERAND_OFFSET, // 16-bit offset; a label gives its address, relocated by the linker
+    OPERAND_BRANCH, // 16-bit offset; a label must be local and is pc-relative
+    OPERAND_WORD    // 32-bit value; a label gives its address, relocated by the linker
+};
+
+// Describes one mnemonic. opcode is the value of bits 24-22; relocation is
+// how the linker patches a label operand of kind OFFSET or WORD.
+struct OpcodeInfo
+{
+    const char *mnemonic;
+    int opcode;
+    enum Format format;
+    enum Operand operands[3];
+    enum RelocationOpcode relocation;
+};
+
+// One tokenized source line. Missing fields have length 0.
+struct Instruction
+{
+    const OpcodeInfo *info; // NULL if the opcode is not recognized
+    Token label;
+    Token opcode;
+    Token arg0;
+    Token arg1;
+    Token arg2;
+};
+
+typedef struct Symbol Symbol;
+typedef struct SymbolTable SymbolTable;
+
+// Every label defined or referenced as a global in the file.
+struct Symbol
+{
+    Token *label;
+    int address; // line of the definition, -1 if the symbol is undefined
+    int offset;   // offset of the definition within its T/D section
+    char area;    // T/D/U
+    bool global;
+    int exported; // index in the object file's symbol table, -1 if not there
+};
+
+// Hashed symbol table. slots hold 1 + index into symbols, 0 for empty, and
+// numSlots is a power of two kept at least twice size.
+// exported lists the symbols written to the object file's symbol table, in
+// output order: defined globals first, then undefined ones by first use.
+struct SymbolTable
+{
+    Arena *arena;
+    Symbol *symbols;
+    int *slots;
+    int *exported;
+    int size;
+    int capacity;
+    int numSlots;
+    int exportedSize;
+    int exportedCapacity;
+};
+
+static int readAndParse(const char *line, const char *end, Instruction *inst);
+static const OpcodeInfo *lookupOpcode(Token *opcode);
+static int encodeInstruction(Diagnostic *diagnostic, Instruction *inst, int pc, SymbolTable *symbols, int *word);
+static void *growTable(Arena *arena, void *table, int *capacity, size_t elementSize);
+static int tokenizeSource(Diagnostic *diagnostic, const char *source, size_t size, Instruction *insts, int *lines);
+static inline bool tokenEquals(Token *token, const char *string);
+static int initSymbolTable(SymbolTable *table, Arena *arena);
+static Symbol *findSymbol(SymbolTable *table, Token *label);
+static int exportSymbol(SymbolTable *table, Symbol *symbol);
+static Symbol *addSymbol(SymbolTable *table, Token *label);
+static inline Symbol *findLabel(SymbolTable *table, Token *label);
+static inline int isGlobalSymbol(Token *token);
+static int assembleSource(Diagnostic *diagnostic, const char *source, size_t sourceSize, enum ObjectFormat format,
+                          Arena *arena, OutputBuffer *out);
+
+// Records why the source at line could not be assembled and returns status,
+// so error paths read "return fail(diagnostic, ...)".
+static int
+fail(Diagnostic *diagnostic, enum DiagnosticCode code, int status, int line, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    setDiagnosticV(diagnostic, code, status, format, args);
+    va_end(args);
+    diagnostic->line = line;
+    return status;
+}
+
+// Fails because memory ran out, as the assembler command does.
+static int
+failMemory(Diagnostic *diagnostic)
+{
+    return fail(diagnostic, DIAGNOSTIC_MEMORY, 1, -1, "error: out of memory\n");
+}
+
+int assembleBuffer(const char *source, size_t size, enum ObjectFormat format, OutputBuffer *out,
+                   Diagnostic *diagnostic)
+{
+    Arena arena = {NULL};
+    clearDiagnostic(diagnostic);
+    int status = assembleSource(diagnostic, source, size, format, &arena, out);
+    arenaFree(&arena);
+    return status;
+}
+
+int loadSource(AssemblyJob *job, const char **source, size_t *size, bool *mapped)
+{
+    clearDiagnostic(&job->diagnostic);
+    *mapped = false;
+    if (!strcmp(job->inFileString, "-"))
+        return (*source = readStream(stdin, size)) != NULL ? 0 : failMemory(&job->diagnostic);
+    if (loadFile(job->inFileString, source, size, mapped) != 0)
+        return setDiagnostic(&job->diagnostic, DIAGNOSTIC_IO, 1, "error in opening %s\n", job->inFileString);
+    return 0;
+}
+
+int assembleFile(AssemblyJob *job, const char *source, size_t size, char **object, size_t *objectSize)
+{
+    OutputBuffer out;
+    if (openMemoryOutput(&out) != 0)
+        return failMemory(&job->diagnostic);
+    int status = assembleBuffer(source, size, job->format, &out, &job->diagnostic);
+    char *bytes = NULL;
+    size_t length = 0;
+    if (takeOutput(&out, &bytes, &length) != 0 && status == 0)
+        status = failMemory(&job->diagnostic);
+
+    status = writeAssembly(job, status, bytes, length);
+    if (status == 0 && object != NULL)
+    {
+        *object = bytes;
+        *objectSize = length;
+    }
+    else
+        free(bytes);
+    return status;
+}
+
+int writeAssembly(AssemblyJob *job, int status, const char *object, size_t size)
+{
+    enum DiagnosticCode code = job->diagnostic.code;
+    if (code == DIAGNOSTIC_LINE_TOO_LONG || code == DIAGNOSTIC_BLANK_LINE)
+        return status;
+
+    // a write that fails after the assembly did keeps the assembly's diagnostic
+    OutputBuffer out;
+    int opened = openOutput(&out, job->outFileString);
+    if (opened != 0)
+    {
+        if (status != 0)
+            return status;
+        if (opened == -2)
+            return failMemory(&job->diagnostic);
+        return setDiagnostic(&job->diagnostic, DIAGNOSTIC_IO, 1, "error in opening %s\n", job->outFileString);
+    }
+    if (status == 0)
+        writeBytes(&out, object, size);
+    if (closeOutput(&out) != 0 && status == 0)
+        status = setDiagnostic(&job->diagnostic, DIAGNOSTIC_IO, 1, "error in writing %s\n", job->outFileString);
+    return status;
+}
+
+int reportAssembly(FILE *out, AssemblyJob *jobs, int numJobs)
+{
+    int status = 0;
+    for (int i = 0; i < numJobs; ++i)
+    {
+        Diagnostic *diagnostic = &jobs[i].diagnostic;
+        if (diagnostic->status == 0)
+            continue;
+        size_t length = strlen(diagnostic->message);
+        bool newline = length && diagnostic->message[length - 1] == '\n';
+        fprintf(out, "%s: %s%s", jobs[i].inFileString, diagnostic->message, newline ? "" : "\n");
+        if (status == 0)
+            status = diagnostic->status;
+    }
+    return status;
+}
+
+// Assembles the tokenized source into the object file. Everything built here
+// lives in arena; nothing is written to out unless the whole source is valid.
+static int
+assembleSource(Diagnostic *diagnostic, const char *source, size_t sourceSize, enum ObjectFormat format,
+               Arena *arena, OutputBuffer *out)
+{
+    // one instruction record per line
+    size_t maxLines = 1;
+    for (size_t i = 0; i < sourceSize; ++i)
+    {
+        if (source[i] == '\n')
+            ++maxLines;
+    }
+    Instruction *insts = arenaAlloc(arena, maxLines * sizeof(Instruction));
+    if (insts == NULL)
+        return failMemory(diagnostic);
+
+    // Checks for long lines and blank lines in the middle of the code.
+    int lines;
+    if (tokenizeSource(diagnostic, source, sourceSize, insts, &lines) != 0)
+        return diagnostic->status;
+
+    SymbolTable symbols;
+    if (initSymbolTable(&symbols, arena) != 0)
+        return failMemory(diagnostic);
+    int rtIndex = 0;
+    int rtCapacity = 0;
+    ObjectRelocation *relocations = NULL; // instructions and fills that use symbols
+    int fixupIndex = 0;
+    int fixupCapacity = 0;
+    Token **fixups = NULL; // global operands that may still be undefined
+    int textSize = 0;
+    int dataSize = 0;
+
+    // collect labels, defined globals and relocations from the records
+    for (int pc = 0; pc < lines; ++pc)
+    {
+        Instruction *inst = &insts[pc];
+        Token *label = &inst->label;
+        inst->info = lookupOpcode(&inst->opcode);
+        bool isFill = inst->info != NULL && inst->info->format == FORMAT_FILL;
+        if (isFill)
+            dataSize += 1;
+        else
+            textSize += 1;
+
+        // if the lable is not empty, we store its address
+        if (label->length)
+        {
+            // check duplicate labels
+            if (findSymbol(&symbols, label) != NULL)
+                return fail(diagnostic, DIAGNOSTIC_DUPLICATE_LABEL, 1, pc, "Duplicate definition of labels");
+            Symbol *symbol = addSymbol(&symbols, label);
+            if (symbol == NULL)
+                return failMemory(diagnostic);
+            symbol->address = pc;
+            if (isFill)
+            {
+                symbol->area = 'D';
+                symbol->offset = dataSize - 1;
+            }
+            else
+            {
+                symbol->area = 'T';
+                symbol->offset = textSize - 1;
+            }
+
+            // update defined global labels to symbol table
+            if (symbol->global && exportSymbol(&symbols, symbol) != 0)
+                return failMemory(diagnostic);
+        }
+
+        // update relocation table (instructions and fills that use symbols)
+        // symbol address only appear in lw, sw, or .fill as arguments (not label)
+        Token *symbol = NULL;
+        if (inst->info != NULL)
+        {
+            Token *args[3] = {&inst->arg0, &inst->arg1, &inst->arg2};
+            for (int i = 0; i < 3; ++i)
+            {
+                enum Operand operand = inst->info->operands[i];
+                if ((operand == OPERAND_OFFSET || operand == OPERAND_WORD) && !args[i]->isNumber)
+                    symbol = args[i];
+            }
+        }
+        if (symbol != NULL)
+        {
+            if (rtIndex == rtCapacity &&
+                (relocations = growTable(arena, relocations, &rtCapacity, sizeof(ObjectRelocation))) == NULL)
+                return failMemory(diagnostic);
+            relocations[rtIndex].offset = isFill ? dataSize - 1 : textSize - 1;
+            relocations[rtIndex].opcode = inst->info->relocation;
+            relocations[rtIndex].section = isFill ? SECTION_DATA : SECTION_TEXT;
+            relocations[rtIndex].symbol = OBJECTLOCAL;
+            relocations[rtIndex].label = symbol->start;
+            relocations[rtIndex].length = symbol->length;
+
+            // a global used before its definition is resolved once all labels
+            // are known; until then symbol holds its fixup
+            if (isGlobalSymbol(symbol))
+            {
+                if (fixupIndex == fixupCapacity &&
+                    (fixups = growTable(arena, fixups, &fixupCapacity, sizeof(Token *))) == NULL)
+                    return failMemory(diagnostic);
+                relocations[rtIndex].symbol = fixupIndex;
+                fixups[fixupIndex++] = symbol;
+            }
+            ++rtIndex;
+        }
+    }
+
+    // resolve fixups: globals never defined in this file become undefined (U) entries
+    for (int i = 0; i < fixupIndex; ++i)
+    {
+        if (findSymbol(&symbols, fixups[i]) != NULL)
+            continue;
+        Symbol *symbol = addSymbol(&symbols, fixups[i]);
+        if (symbol == NULL || exportSymbol(&symbols, symbol) != 0)
+            return failMemory(diagnostic);
+    }
+    // relocations of globals refer to their symbol by its index in the table
+    for (int i = 0; i < rtIndex; ++i)
+    {
+        if (relocations[i].symbol != OBJECTLOCAL)
+            relocations[i].symbol = findSymbol(&symbols, fixups[relocations[i].symbol])->exported;
+    }
+
+    // text words come first in the object file, then data, in source order
+    int *words = arenaAlloc(arena, (lines + 1) * sizeof(int));
+    if (words == NULL)
+        return failMemory(diagnostic);
+    for (int pc = 0; pc < lines; ++pc) // pc is used for beq
+    {
+        Instruction *inst = &insts[pc];
+        if (inst->info == NULL)
+        {
+            return fail(diagnostic, DIAGNOSTIC_UNRECOGNIZED_OPCODE, 1, pc,
+                        "Unrecognized opcodes\n%.*s  %.*s  %.*s  %.*s\n", inst->opcode.length,
+                        inst->opcode.start, inst->arg0.length, inst->arg0.start, inst->arg1.length,
+                        inst->arg1.start, inst->arg2.length, inst->arg2.start);
+        }
+        if (encodeInstruction(diagnostic, inst, pc, &symbols, &words[pc]) != 0)
+            return diagnostic->status;
+    }
+
+    ObjectSymbol *objectSymbols = arenaAlloc(arena, (symbols.exportedSize + 1) * sizeof(ObjectSymbol));
+    if (objectSymbols == NULL)
+        return failMemory(diagnostic);
+    for (int i = 0; i < symbols.exportedSize; ++i)
+    {
+        Symbol *symbol = &symbols.symbols[symbols.exported[i]];
+        objectSymbols[i].label = symbol->label->start;
+        objectSymbols[i].length = symbol->label->length;
+        objectSymbols[i].area = symbol->area;
+        objectSymbols[i].offset = symbol->offset;
+    }
+
+    ObjectFile object = {
+        .textSize = textSize,
+        .dataSize = dataSize,
+        .symbolTableSize = symbols.exportedSize,
+        .relocationTableSize = rtIndex,
+        .text = words,
+        .data = words + textSize,
+        .symbols = objectSymbols,
+        .relocations = relocations,
+    };
+    if (writeObject(out, &object, format) != 0)
+        return failMemory(diagnostic);
+    return 0;
+}
+
+// Character classes of the tokenizer, indexed by unsigned char.
+// Fields are separated by tab, newline, carriage return and space, but a
+// label only ends at tab, newline or space.
+#define CHARSPACE 1
+#define CHARLABELEND 2
+#define CHARDIGIT 4
+
+static const unsigned char charClass[256] = {
+    ['\t'] = CHARSPACE | CHARLABELEND,
+    ['\n'] = CHARSPACE | CHARLABELEND,
+    ['\r'] = CHARSPACE,
+    [' '] = CHARSPACE | CHARLABELEND,
+    ['0'] = CHARDIGIT, ['1'] = CHARDIGIT, ['2'] = CHARDIGIT, ['3'] = CHARDIGIT,
+    ['4'] = CHARDIGIT, ['5'] = CHARDIGIT, ['6'] = CHARDIGIT, ['7'] = CHARDIGIT,
+    ['8'] = CHARDIGIT, ['9'] = CHARDIGIT,
+};
+
+static inline bool
+hasClass(char c, unsigned char cls)
+{
+    return charClass[(unsigned char)c] & cls;
+}
+
+// Returns non-zero if the line [line, end) contains only whitespace.
+static int lineIsBlank(const char *line, const char *end)
+{
+    for (; line < end; ++line)
+    {
+        if (!hasClass(*line, CHARSPACE))
+            return 0;
+    }
+    return 1;
+}
+
+// Fills token with the slice [start, start + length) and pre-parses it.
+// A field is a number if it is an optional sign followed by decimal digits,
+// as sscanf("%d%c") accepts; value saturates to a long and is then truncated
+// to an int, exactly what atoi does.
+static void
+makeToken(Token *token, const char *start, int length)
+{
+    token->start = start;
+    token->length = length;
+    token->value = 0;
+    token->reg = -1;
+    token->isNumber = false;
+
+    int i = 0;
+    bool negative = false;
+    if (length && (start[0] == '-' || start[0] == '+'))
+    {
+        negative = start[0] == '-';
+        ++i;
+    }
+    if (i == length)
+        return;
+
+    unsigned long magnitude = 0;
+    bool overflow = false;
+    for (; i < length; ++i)
+    {
+        if (!hasClass(start[i], CHARDIGIT))
+            return;
+        unsigned long digit = start[i] - '0';
+        if (magnitude > (ULONG_MAX - digit) / 10)
+            overflow = true;
+        else
+            magnitude = magnitude * 10 + digit;
+    }
+
+    long number;
+    if (negative)
+        number = (overflow || magnitude > (unsigned long)LONG_MAX + 1) ? LONG_MIN : (long)(0UL - magnitude);
+    else
+        number = (overflow || magnitude > LONG_MAX) ? LONG_MAX : (long)magnitude;
+
+    token->isNumber = true;
+    token->value = (int)number;
+    if (token->value >= 0 && token->value <= 7)
+        token->reg = token->value;
+}
+
+static inline bool
+tokenEquals(Token *token, const char *string)
+{
+    return strlen(string) == (size_t)token->length && !memcmp(token->start, string, token->length);
+}
+
+// Returns a copy of a full arena-backed table with double the capacity, or
+// NULL, leaving capacity alone, if memory ran out. The old storage stays in
+// the arena until it is freed.
+static void *
+growTable(Arena *arena, void *table, int *capacity, size_t elementSize)
+{
+    int newCapacity = *capacity ? 2 * *capacity : INITIALTABLESIZE;
+    void *newTable = arenaAlloc(arena, newCapacity * elementSize);
+    if (newTable == NULL)
+        return NULL;
+    if (*capacity)
+        memcpy(newTable, table, *capacity * elementSize);
+    *capacity = newCapacity;
+    return newTable;
+}
+
+// Splits the source into lines and parses each one into insts. Tokens are
+// slices of source, which must outlive insts. Sets lines to the number of
+// instructions before the first blank line.
+// Fails with status 1 if a line is too long and 2 if the file contains an
+// empty line anywhere other than at the end of the file.
+static int
+tokenizeSource(Diagnostic *diagnostic, const char *source, size_t size, Instruction *insts, int *lines)
+{
+    int count = 0;
+    int blank_line_encountered = 0;
+    int address_of_blank_line = 0;
+    const char *end = source + size;
+
+    for (int address = 0; source < end; ++address)
+    {
+        // a line runs up to and including its newline, like fgets
+        const char *next = memchr(source, '\n', end - source);
+        next = (next == NULL) ? end : next + 1;
+
+        // Check for line too long
+        if (next - source >= MAXLINELENGTH - 1)
+            return fail(diagnostic, DIAGNOSTIC_LINE_TOO_LONG, 1, address, "error: line too long\n");
+
+        // Check for blank line.
+        if (lineIsBlank(source, next))
+        {
+            if (!blank_line_encountered)
+            {
+                blank_line_encountered = 1;
+                address_of_blank_line = address;
+            }
+        }
+        else if (blank_line_encountered)
+            return fail(diagnostic, DIAGNOSTIC_BLANK_LINE, 2, address_of_blank_line,
+                        "Invalid Assembly: Empty line at address %d\n", address_of_blank_line);
+        else
+        {
+            readAndParse(source, next, &insts[count]);
+            ++count;
+        }
+
+        source = next;
+    }
+    *lines = count;
+    return 0;
+}
+
+/*
+ * Parse the line [line, end) of the assembly-language file into inst.
+ * Fields are slices of the line; the label ends at a tab, newline or space,
+ * and up to four more fields follow, each preceded by whitespace.
+ *
+ * Return values:
+ *     0 if the line is blank
+ *     1 if all went well
+ *
+ * The caller has already checked that the line is not too long.
+ */
+static int
+readAndParse(const char *line, const char *end, Instruction *inst)
+{
+    Token *fields[4] = {&inst->opcode, &inst->arg0, &inst->arg1, &inst->arg2};
+    const char *ptr = line;
+
+    /* delete prior values */
+    makeToken(&inst->label, line, 0);
+    for (int i = 0; i < 4; ++i)
+        makeToken(fields[i], line, 0);
+
+    // Ignore blank lines at the end of the file.
+    if (lineIsBlank(line, end))
+    {
+        return 0;
+    }
+
+    /* is there a label? */
+    while (ptr < end && !hasClass(*ptr, CHARLABELEND))
+        ++ptr;
+    makeToken(&inst->label, line, ptr - line);
+
+    /* Parse the rest of the line: whitespace, then a field, four times. */
+    for (int i = 0; i < 4; ++i)
+    {
+        const char *start = ptr;
+        while (ptr < end && hasClass(*ptr, CHARSPACE))
+            ++ptr;
+        if (ptr == start || ptr == end)
+            break;
+        start = ptr;
+        while (ptr < end && !hasClass(*ptr, CHARSPACE))
+            ++ptr;
+        makeToken(fields[i], start, ptr - start);
+    }
+
+    return (1);
+}
+
+// Returns 0, or -1 if memory ran out.
+static int
+initSymbolTable(SymbolTable *table, Arena *arena)
+{
+    table->arena = arena;
+    table->symbols = NULL;
+    table->exported = NULL;
+    table->size = table->capacity = 0;
+    table->exportedSize = table->exportedCapacity = 0;
+    table->numSlots = 2 * INITIALTABLESIZE;
+    table->slots = arenaAlloc(arena, table->numSlots * sizeof(int));
+    if (table->slots == NULL)
+        return -1;
+    memset(table->slots, 0, table->numSlots * sizeof(int));
+    return 0;
+}
+
+// Returns the first free slot for label. The label must not be present.
+static inline unsigned int
+freeSlot(SymbolTable *table, Token *label)
+{
+    unsigned int slot = hashLabel(label->start, label->length) & (table->numSlots - 1);
+    while (table->slots[slot])
+        slot = (slot + 1) & (table->numSlots - 1);
+    return slot;
+}
+
+// Returns the symbol named label, or NULL if it has never been added.
+static Symbol *
+findSymbol(SymbolTable *table, Token *label)
+{
+    unsigned int slot = hashLabel(label->start, label->length) & (table->numSlots - 1);
+    while (table->slots[slot])
+    {
+        Symbol *symbol = &table->symbols[table->slots[slot] - 1];
+        if (symbol->label->length == label->length &&
+            !memcmp(symbol->label->start, label->start, label->length))
+            return symbol;
+        slot = (slot + 1) & (table->numSlots - 1);
+    }
+    return NULL;
+}
+
+// Adds label as an undefined symbol. The caller has checked it is not present.
+// The returned pointer is only valid until the next addSymbol. Returns NULL
+// if memory ran out.
+static Symbol *
+addSymbol(SymbolTable *table, Token *label)
+{
+    if (table->size == table->capacity)
+    {
+        Symbol *symbols = growTable(table->arena, table->symbols, &table->capacity, sizeof(Symbol));
+        if (symbols == NULL)
+            return NULL;
+        table->symbols = symbols;
+    }
+
+    // keep the load factor at or below one half
+    if (2 * (table->size + 1) > table->numSlots)
+    {
+        int *slots = arenaAlloc(table->arena, 2 * table->numSlots * sizeof(int));
+        if (slots == NULL)
+            return NULL;
+        table->numSlots *= 2;
+        table->slots = slots;
+        memset(table->slots, 0, table->numSlots * sizeof(int));
+        for (int i = 0; i < table->size; ++i)
+            table->slots[freeSlot(table, table->symbols[i].label)] = i + 1;
+    }
+
+    Symbol *symbol = &table->symbols[table->size];
+    table->slots[freeSlot(table, label)] = ++table->size;
+    symbol->label = label;
+    symbol->address = -1;
+    symbol->offset = 0;
+    symbol->area = 'U';
+    symbol->global = isGlobalSymbol(label);
+    symbol->exported = -1;
+    return symbol;
+}
+
+// Appends symbol to the object file's symbol table. Returns 0, or -1 if
+// memory ran out.
+static int
+exportSymbol(SymbolTable *table, Symbol *symbol)
+{
+    if (table->exportedSize == table->exportedCapacity)
+    {
+        int *exported = growTable(table->arena, table->exported, &table->exportedCapacity, sizeof(int));
+        if (exported == NULL)
+            return -1;
+        table->exported = exported;
+    }
+    symbol->exported = table->exportedSize;
+    table->exported[table->exportedSize++] = symbol - table->symbols;
+    return 0;
+}
+
+// Returns the symbol if label is defined in this file, otherwise NULL.
+static inline Symbol *
+findLabel(SymbolTable *table, Token *label)
+{
+    Symbol *symbol = findSymbol(table, label);
+    if (symbol == NULL || symbol->area == 'U')
+        return NULL;
+    return symbol;
+}
+
+// assuming all global symbol start with capital letter
+// if the first char is capital letter, return 1. otherwise 0
+static inline int
+isGlobalSymbol(Token *token)
+{
+    if (token->length && token->start[0] >= 'A' && token->start[0] <= 'Z')
+    {
+        return 1; // First letter is uppercase
+    }
+    else
+    {
+        return 0; // First letter is not uppercase
+    }
+}
+
+// Every mnemonic the assembler knows, indexed by opcodeHash.
+static const OpcodeInfo opcodeTable[16] = {
+    [0] = {"nor", 1, FORMAT_R, {OPERAND_REGA, OPERAND_REGB, OPERAND_DEST}},
+    [1] = {"noop", 7, FORMAT_O, {OPERAND_NONE, OPERAND_NONE, OPERAND_NONE}},
+    [5] = {"lw", 2, FORMAT_I, {OPERAND_REGA, OPERAND_REGB, OPERAND_OFFSET}, RELOC_LW},
+    [8] = {"add", 0, FORMAT_R, {OPERAND_REGA, OPERAND_REGB, OPERAND_DEST}},
+    [9] = {".fill", 0, FORMAT_FILL, {OPERAND_WORD, OPERAND_NONE, OPERAND_NONE}, RELOC_FILL},
+    [10] = {"beq", 4, FORMAT_I, {OPERAND_REGA, OPERAND_REGB, OPERAND_BRANCH}},
+    [12] = {"sw", 3, FORMAT_I, {OPERAND_REGA, OPERAND_REGB, OPERAND_OFFSET}, RELOC_SW},
+    [13] = {"halt", 6, FORMAT_O, {OPERAND_NONE, OPERAND_NONE, OPERAND_NONE}},
+    [15] = {"jalr", 5, FORMAT_J, {OPERAND_REGA, OPERAND_REGB, OPERAND_NONE}},
+};
+
+// Perfect hash of the mnemonics above into the 16 table slots.
+static inline unsigned int
+opcodeHash(Token *opcode)
+{
+    return (opcode->start[0] + opcode->start[1] + opcode->length) & 15;
+}
+
+// Returns the descriptor for opcode, or NULL if it is not a mnemonic.
+static const OpcodeInfo *
+lookupOpcode(Token *opcode)
+{
+    if (opcode->length < 2)
+        return NULL;
+    const OpcodeInfo *info = &opcodeTable[opcodeHash(opcode)];
+    if (info->mnemonic == NULL || !tokenEquals(opcode, info->mnemonic))
+        return NULL;
+    return info;
+}
+
+// Sets value to the value of an offset or .fill operand, resolving labels.
+static int
+resolveOperand(Diagnostic *diagnostic, enum Operand operand, Token *arg, int pc, SymbolTable *symbols,
+               int *value)
+{
+    if (!arg->isNumber)
+    { // offset is a symbolic address
+        Symbol *symbol = findLabel(symbols, arg);
+        if (symbol != NULL)
+        {
+            if (operand == OPERAND_BRANCH)
+                *value = (symbol->address - pc - 1) & 0xFFFF;
+            else if (operand == OPERAND_OFFSET)
+                *value = symbol->address & 0xFFFF;
+            else
+                *value = symbol->address;
+            return 0;
+        }
+        // if label is global, it resolves to 0 and the linker fills it in
+        if (operand == OPERAND_BRANCH || !isGlobalSymbol(arg))
+            return fail(diagnostic, DIAGNOSTIC_UNDEFINED_LABEL, 1, pc, "Use of undefined labels\n");
+        *value = 0;
+        return 0;
+    }
+
+    if (operand == OPERAND_WORD)
+    {
+        *value = arg->value;
+        return 0;
+    }
+    if (arg->value > 32767 || arg->value < -32768)
+        return fail(diagnostic, DIAGNOSTIC_OFFSET_RANGE, 1, pc, "offsetFields that don’t fit in 16 bits\n");
+    *value = arg->value & 0xFFFF;
+    return 0;
+}
+
+// Encodes a recognized instruction or .fill as described by its OpcodeInfo
+// into word.
+static int
+encodeInstruction(Diagnostic *diagnostic, Instruction *inst, int pc, SymbolTable *symbols, int *word)
+{
+    const OpcodeInfo *info = inst->info;
+    Token *args[3] = {&inst->arg0, &inst->arg1, &inst->arg2};
+
+    // all registers are checked before any offset is resolved
+    for (int i = 0; i < 3; ++i)
+    {
+        enum Operand operand = info->operands[i];
+        if ((operand == OPERAND_REGA || operand == OPERAND_REGB || operand == OPERAND_DEST) &&
+            args[i]->reg < 0)
+            return fail(diagnostic, DIAGNOSTIC_INVALID_REGISTER, 1, pc, "%s Invalid register argument\n",
+                        info->mnemonic);
+    }
+
+    int mc = info->opcode << 22;
+    for (int i = 0; i < 3; ++i)
+    {
+        switch (info->operands[i])
+        {
+        case OPERAND_NONE:
+            break;
+        case OPERAND_REGA:
+            mc |= args[i]->reg << 19;
+            break;
+        case OPERAND_REGB:
+            mc |= args[i]->reg << 16;
+            break;
+        case OPERAND_DEST:
+            mc |= args[i]->reg;
+            break;
+        default:
+        {
+            int value;
+            if (resolveOperand(diagnostic, info->operands[i], args[i], pc, symbols, &value) != 0)
+                return diagnostic->status;
+            mc |= value;
+            break;
+        }
+        }
+    }
+    *word = mc;
+    return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Project 2
+ * LC-2K assembler, as a library the assembler command and server share
+ */
+
+#ifndef ASSEMBLE_H
+#define ASSEMBLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "diagnostic.h"
+#include "object.h"
+#include "outbuf.h"
+
+// Lines of this length or longer are rejected. Files may have any number of lines.
+#define MAXLINELENGTH 1000
+
+typedef struct AssemblyJob AssemblyJob;
+
+// One source file to assemble into an object file of the given format.
+// Jobs share no state, so any number of them can run at once. A job that
+// fails keeps what the assembler command would have printed, and its exit
+// status, in diagnostic.
+struct AssemblyJob
+{
+    const char *inFileString;
+    const char *outFileString;
+    enum ObjectFormat format;
+    Diagnostic diagnostic;
+};
+
+// Assembles size bytes of LC-2K source into an object file of the given
+// format, written to out, which may be a file or memory output. Nothing is
+// written unless the whole source assembles. Returns 0 on success, otherwise
+// the assembler's exit status, with diagnostic saying why. Calls share no
+// state, so any number may run at once.
+int assembleBuffer(const char *source, size_t size, enum ObjectFormat format, OutputBuffer *out,
+                   Diagnostic *diagnostic);
+
+// Gets the bytes of job's source as loadFile does, "-" meaning standard
+// input. unloadFile releases them. Returns 0 on success, otherwise the exit
+// status, with job->diagnostic saying why.
+int loadSource(AssemblyJob *job, const char **source, size_t *size, bool *mapped);
+
+// Assembles size bytes of source and writes the object file of job as
+// writeAssembly does. On success, unless object is NULL, *object and
+// *objectSize are set to the object's bytes for the caller to free().
+// Returns like loadSource.
+int assembleFile(AssemblyJob *job, const char *source, size_t size, char **object, size_t *objectSize);
+
+// Writes the object file of job given status, the result of assembling it.
+// A source that fails the line checks leaves no output. One that fails
+// later still leaves the (empty) output behind, as it always has. Returns
+// status, or the exit status of a failed write, with job->diagnostic saying
+// why.
+int writeAssembly(AssemblyJob *job, int status, const char *object, size_t size);
+
+// Prints the diagnostic of every failed job to out in job order, each
+// prefixed with its source file, as a batch reports them. Returns the exit
+// status of the first failed job, or 0.
+int reportAssembly(FILE *out, AssemblyJob *jobs, int numJobs);
+
+#endif
@@ -0,0 +1,258 @@
+/**
+ * Project 2
+ * Command lines of the LC-2K assembler and linker, parsed the same way by the
+ * commands themselves and by the server that runs them for clients
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "command.h"
+
+// Initial capacities of the assembler's batch and the linker's inputs; each
+// doubles whenever it fills up.
+#define INITIALSOURCES 64
+#define INITIALINPUTS 16
+
+static int readResponseFile(const char *path, Arena *arena, char **text, size_t *size, Diagnostic *diagnostic);
+static int addSource(AssemblerCommand *command, int *capacity, Arena *arena, const char *inFileString,
+                     const char *outFileString);
+static int addInput(LinkerCommand *command, int *capacity, Arena *arena, const char *name);
+
+static int
+failMemory(Diagnostic *diagnostic)
+{
+    return setDiagnostic(diagnostic, DIAGNOSTIC_MEMORY, 1, "error: out of memory\n");
+}
+
+static int
+failAssemblerUsage(Diagnostic *diagnostic, const char *program)
+{
+    return setDiagnostic(diagnostic, DIAGNOSTIC_USAGE, 1,
+                         "error: usage: %s [-b] <assembly-code-file> <machine-code-file>\n"
+                         "       %s [-b] -m <assembly-code-file>... | @<response-file>\n",
+                         program, program);
+}
+
+int parseAssemblerCommand(int argc, char **argv, Arena *arena, AssemblerCommand *command, Diagnostic *diagnostic)
+{
+    char *program = argv[0];
+    command->format = OBJECT_TEXT;
+    command->batch = false;
+    command->sources = NULL;
+    command->numSources = 0;
+    clearDiagnostic(diagnostic);
+
+    // -b writes the binary object format; -m assembles many files at once
+    while (argc > 1 && (!strcmp(argv[1], "-b") || !strcmp(argv[1], "-m")))
+    {
+        if (argv[1][1] == 'b')
+            command->format = OBJECT_BINARY;
+        else
+            command->batch = true;
+        --argc;
+        ++argv;
+    }
+
+    int capacity = 0;
+    if (!command->batch)
+    {
+        if (argc != 3)
+            return failAssemblerUsage(diagnostic, program);
+        return addSource(command, &capacity, arena, argv[1], argv[2]) != 0 ? failMemory(diagnostic) : 0;
+    }
+
+    // each source x.as is written to x.obj; a response file lists
+    // "source [object]" per line
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '@')
+        {
+            if (addSource(command, &capacity, arena, argv[i], NULL) != 0)
+                return failMemory(diagnostic);
+            continue;
+        }
+        char *text;
+        size_t size;
+        if (readResponseFile(argv[i] + 1, arena, &text, &size, diagnostic) != 0)
+            return diagnostic->status;
+        for (char *line = text; line < text + size;)
+        {
+            char *next = memchr(line, '\n', text + size - line);
+            next = (next == NULL) ? text + size : next + 1;
+            char *names[2] = {NULL, NULL};
+            for (int j = 0; j < 2; ++j)
+            {
+                while (line < next && isspace((unsigned char)*line))
+                    *line++ = '\0';
+                if (line == next)
+                    break;
+                names[j] = line;
+                while (line < next && !isspace((unsigned char)*line))
+                    ++line;
+            }
+            // terminate the last name; a newline is overwritten, the final NUL already ends the text
+            if (line < next)
+                *line = '\0';
+            if (names[0] != NULL && addSource(command, &capacity, arena, names[0], names[1]) != 0)
+                return failMemory(diagnostic);
+            line = next;
+        }
+    }
+    // a batch with nothing to assemble is a mistake, not a success
+    return command->numSources == 0 ? failAssemblerUsage(diagnostic, program) : 0;
+}
+
+int parseLinkerCommand(int argc, char **argv, Arena *arena, LinkerCommand *command, Diagnostic *diagnostic)
+{
+    char *program = argv[0];
+    command->streaming = false;
+    command->incremental = false;
+    command->reportFileString = NULL;
+    command->outFileString = NULL;
+    command->inputs = NULL;
+    command->numInputs = 0;
+    clearDiagnostic(diagnostic);
+
+    // -s streams the executable, holding only one module in memory at a time;
+    // -i patches the executable of the previous link when only some object
+    // files changed, without changing size; -r writes a JSON report of the
+    // link to the file that follows it
+    for (; argc > 1 && (!strcmp(argv[1], "-s") || !strcmp(argv[1], "-i") || !strcmp(argv[1], "-r")); --argc, ++argv)
+    {
+        if (argv[1][1] == 's')
+            command->streaming = true;
+        else if (argv[1][1] == 'i')
+            command->incremental = true;
+        else if (argc > 2)
+        {
+            command->reportFileString = argv[2];
+            --argc;
+            ++argv;
+        }
+        else
+            break;
+    }
+
+    if (argc <= 2)
+        return setDiagnostic(diagnostic, DIAGNOSTIC_USAGE, 1,
+                             "error: usage: %s [-s] [-i] [-r <report-file>] <MAIN-object-file> ... <object-file> ... "
+                             "<output-exe-file>\n"
+                             "       object files may also be listed in a response file named as @<file>;\n"
+                             "       archive members are linked only if they define a label still undefined\n",
+                             program);
+    command->outFileString = argv[argc - 1];
+
+    // @file arguments are replaced by the whitespace-separated names in file
+    int capacity = 0;
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        if (argv[i][0] != '@')
+        {
+            if (addInput(command, &capacity, arena, argv[i]) != 0)
+                return failMemory(diagnostic);
+            continue;
+        }
+        char *text;
+        size_t size;
+        if (readResponseFile(argv[i] + 1, arena, &text, &size, diagnostic) != 0)
+            return diagnostic->status;
+        char *next;
+        for (char *name = strtok_r(text, " \t\r\n", &next); name != NULL; name = strtok_r(NULL, " \t\r\n", &next))
+            if (addInput(command, &capacity, arena, name) != 0)
+                return failMemory(diagnostic);
+    }
+    return 0;
+}
+
+int takeFingerprint(const char *path, Fingerprint *fingerprint)
+{
+    struct stat info;
+    memset(fingerprint, 0, sizeof(*fingerprint));
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        return -1;
+    fingerprint->size = info.st_size;
+    fingerprint->inode = info.st_ino;
+    fingerprint->seconds = info.st_mtim.tv_sec;
+    fingerprint->nanoseconds = info.st_mtim.tv_nsec;
+    return 0;
+}
+
+// Sets text to a NUL-terminated copy in arena of the response file at path,
+// which the caller splits into names in place.
+static int
+readResponseFile(const char *path, Arena *arena, char **text, size_t *size, Diagnostic *diagnostic)
+{
+    const char *buffer;
+    bool mapped;
+    if (loadFile(path, &buffer, size, &mapped) != 0)
+        return setDiagnostic(diagnostic, DIAGNOSTIC_IO, 1, "error in opening %s\n", path);
+    *text = arenaString(arena, buffer, *size);
+    unloadFile(buffer, *size, mapped);
+    return *text != NULL ? 0 : failMemory(diagnostic);
+}
+
+// Appends a source. outFileString defaults to inFileString with its
+// extension replaced by .obj (or .obj appended if it has none). Returns 0,
+// or -1 if memory ran out.
+static int
+addSource(AssemblerCommand *command, int *capacity, Arena *arena, const char *inFileString,
+          const char *outFileString)
+{
+    if (command->numSources == *capacity)
+    {
+        int grownCapacity = *capacity ? 2 * *capacity : INITIALSOURCES;
+        AssemblerSource *grown = arenaAlloc(arena, grownCapacity * sizeof(AssemblerSource));
+        if (grown == NULL)
+            return -1;
+        if (command->numSources)
+            memcpy(grown, command->sources, command->numSources * sizeof(AssemblerSource));
+        command->sources = grown;
+        *capacity = grownCapacity;
+    }
+
+    if (outFileString == NULL)
+    {
+        const char *base = strrchr(inFileString, '/');
+        const char *dot = strrchr(base ? base : inFileString, '.');
+        size_t stem = dot ? (size_t)(dot - inFileString) : strlen(inFileString);
+        char *name = arenaAlloc(arena, stem + sizeof(".obj"));
+        if (name == NULL)
+            return -1;
+        memcpy(name, inFileString, stem);
+        strcpy(name + stem, ".obj");
+        outFileString = name;
+    }
+
+    AssemblerSource *source = &command->sources[command->numSources++];
+    source->inFileString = inFileString;
+    source->outFileString = outFileString;
+    return 0;
+}
+
+// Appends name to the files to link. Returns 0, or -1 if memory ran out.
+static int
+addInput(LinkerCommand *command, int *capacity, Arena *arena, const char *name)
+{
+    if (command->numInputs == *capacity)
+    {
+        int grownCapacity = *capacity ? 2 * *capacity : INITIALINPUTS;
+        LinkInput *grown = arenaAlloc(arena, grownCapacity * sizeof(LinkInput));
+        if (grown == NULL)
+            return -1;
+        if (command->numInputs)
+            memcpy(grown, command->inputs, command->numInputs * sizeof(LinkInput));
+        command->inputs = grown;
+        *capacity = grownCapacity;
+    }
+    LinkInput *input = &command->inputs[command->numInputs++];
+    input->name = name;
+    input->bytes = NULL;
+    input->size = 0;
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * Project 2
+ * Command lines of the LC-2K assembler and linker, parsed the same way by the
+ * commands themselves and by the server that runs them for clients
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "diagnostic.h"
+#include "link.h"
+#include "object.h"
+
+typedef struct AssemblerSource AssemblerSource;
+typedef struct AssemblerCommand AssemblerCommand;
+typedef struct LinkerCommand LinkerCommand;
+typedef struct Fingerprint Fingerprint;
+
+// A source file to assemble and the object file to write.
+struct AssemblerSource
+{
+    const char *inFileString;
+    const char *outFileString;
+};
+
+// "assembler [-b] <source> <object>", or with -m any number of sources,
+// each written next to itself as .obj, and @files listing "source [object]"
+// per line.
+struct AssemblerCommand
+{
+    enum ObjectFormat format;
+    bool batch;
+    AssemblerSource *sources;
+    int numSources;
+};
+
+// "linker [-s] [-i] [-r <report>] <object>... <executable>", where an
+// @file stands for the whitespace-separated names in it. The inputs name
+// files; their bytes are left NULL.
+struct LinkerCommand
+{
+    bool streaming;
+    bool incremental;
+    const char *reportFileString; // NULL without -r
+    const char *outFileString;
+    LinkInput *inputs;
+    int numInputs;
+};
+
+// Tells whether a file changed since it was last seen, the way make does.
+struct Fingerprint
+{
+    uint64_t size;
+    uint64_t inode;
+    uint64_t seconds;
+    uint64_t nanoseconds;
+};
+
+// Each parses argv, argv[0] being the name the command was run as, into
+// command. Names point into argv or into text allocated from arena. Returns
+// 0, or the command's exit status with diagnostic holding what it prints:
+// its usage, a response file that cannot be read or memory running out.
+int parseAssemblerCommand(int argc, char **argv, Arena *arena, AssemblerCommand *command, Diagnostic *diagnostic);
+int parseLinkerCommand(int argc, char **argv, Arena *arena, LinkerCommand *command, Diagnostic *diagnostic);
+
+// Only regular files have a fingerprint; any other file fails with -1.
+int takeFingerprint(const char *path, Fingerprint *fingerprint);
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * Project 2
+ * Errors reported by the LC-2K assembler and linker libraries
+ */
+
+#include <stdio.h>
+
+#include "diagnostic.h"
+
+void clearDiagnostic(Diagnostic *diagnostic)
+{
+    diagnostic->code = DIAGNOSTIC_NONE;
+    diagnostic->status = 0;
+    diagnostic->line = -1;
+    diagnostic->input = -1;
+    diagnostic->message[0] = '\0';
+}
+
+int setDiagnostic(Diagnostic *diagnostic, enum DiagnosticCode code, int status, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    setDiagnosticV(diagnostic, code, status, format, args);
+    va_end(args);
+    return status;
+}
+
+int setDiagnosticV(Diagnostic *diagnostic, enum DiagnosticCode code, int status, const char *format,
+                   va_list args)
+{
+    clearDiagnostic(diagnostic);
+    diagnostic->code = code;
+    diagnostic->status = status;
+    vsnprintf(diagnostic->message, sizeof(diagnostic->message), format, args);
+    return status;
+}
@@ -0,0 +1,58 @@
+/**
+ * Project 2
+ * Errors reported by the LC-2K assembler and linker libraries
+ */
+
+#ifndef DIAGNOSTIC_H
+#define DIAGNOSTIC_H
+
+#include <stdarg.h>
+
+// Room for the longest diagnostic, which echoes the fields of one source line.
+#define DIAGNOSTICLENGTH 2000
+
+typedef struct Diagnostic Diagnostic;
+
+enum DiagnosticCode
+{
+    DIAGNOSTIC_NONE,
+    DIAGNOSTIC_IO,                  // a file cannot be opened, read or written
+    DIAGNOSTIC_MEMORY,              // memory ran out
+    DIAGNOSTIC_LINE_TOO_LONG,       // a source line is too long
+    DIAGNOSTIC_BLANK_LINE,          // a blank line is followed by code
+    DIAGNOSTIC_UNRECOGNIZED_OPCODE, // a source line has no known mnemonic
+    DIAGNOSTIC_DUPLICATE_LABEL,     // a label is defined twice in one source
+    DIAGNOSTIC_INVALID_REGISTER,    // a register field is not 0-7
+    DIAGNOSTIC_OFFSET_RANGE,        // an offset field does not fit in 16 bits
+    DIAGNOSTIC_UNDEFINED_LABEL,     // a label is used but never defined
+    DIAGNOSTIC_NO_INPUTS,           // there is nothing to link
+    DIAGNOSTIC_INVALID_OBJECT,      // an input is not a well-formed object or archive
+    DIAGNOSTIC_CHANGED_INPUT,       // an input changed while it was being linked
+    DIAGNOSTIC_LOCAL_STACK,         // an object defines Stack
+    DIAGNOSTIC_DUPLICATE_GLOBAL,    // two objects define the same global
+    DIAGNOSTIC_RELOCATION_RANGE,    // a relocation falls outside its object
+    DIAGNOSTIC_USAGE                // a command line is malformed
+};
+
+// What made a library call fail. status is the exit status of the
+// command-line tool for the same failure and message what it prints. line is
+// the source line (from 0) of an assembler error and input the index of the
+// linker input at fault; either is -1 if it does not apply.
+struct Diagnostic
+{
+    enum DiagnosticCode code;
+    int status;
+    int line;
+    int input;
+    char message[DIAGNOSTICLENGTH];
+};
+
+void clearDiagnostic(Diagnostic *diagnostic);
+
+// Fills in diagnostic, formatting message like printf, and returns status,
+// so error paths read "return setDiagnostic(...)".
+int setDiagnostic(Diagnostic *diagnostic, enum DiagnosticCode code, int status, const char *format, ...);
+int setDiagnosticV(Diagnostic *diagnostic, enum DiagnosticCode code, int status, const char *format,
+                   va_list args);
+
+#endif
@@ -0,0 +1,1826 @@
+/**
+ * Project 2
+ * LC-2K linker, as a library the linker command and server share
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "archive.h"
+#include "command.h"
+#include "link.h"
+#include "object.h"
+
+// Initial capacity of the labels seen while choosing archive members.
+#define INITIALLABELS 64
+
+// An incremental link keeps its state next to the executable, in a file named
+// after it with this suffix, for the next link to patch the executable.
+#define LINKSTATESUFFIX ".link"
+#define LINKSTATEMAGIC "LC2KLNK"
+#define LINKSTATEMAGICSIZE 8
+#define LINKSTATEVERSION 2
+
+// Every executable word is written as "0x%08X\n".
+#define WORDWIDTH 11
+
+// Words an incremental link formats at once when it patches a file's words.
+#define PATCHCHUNK 512
+
+// What a symbol binds to when it is not a merged global: Stack, which sits
+// past the data, or nothing, which is an error only once it is relocated.
+#define BINDSTACK -1
+#define BINDUNDEFINED -2
+
+// The phases of a link the report times. Reading includes choosing archive
+// members; writing includes flushing the executable.
+enum Phase
+{
+    PHASE_READ,
+    PHASE_MERGE,
+    PHASE_RELOCATE,
+    PHASE_WRITE,
+    NUMPHASES
+};
+
+static const char *const phaseNames[NUMPHASES] = {"read", "merge", "relocate", "write"};
+
+// What a relocation resolves to, counted for the report.
+enum RelocationTarget
+{
+    TARGET_LOCAL,
+    TARGET_GLOBAL,
+    TARGET_STACK,
+    NUMTARGETS
+};
+
+static const char *const targetNames[NUMTARGETS] = {"local", "global", "stack"};
+
+typedef struct FileData FileData;
+typedef struct SymbolTableEntry SymbolTableEntry;
+typedef struct CombinedFiles CombinedFiles;
+typedef struct FileInfo FileInfo;
+typedef struct GlobalTable GlobalTable;
+typedef struct LabelSet LabelSet;
+typedef struct RelocationSite RelocationSite;
+typedef struct StateFile StateFile;
+typedef struct LinkState LinkState;
+typedef struct StateReader StateReader;
+typedef struct ReadQueue ReadQueue;
+typedef struct ReadWorker ReadWorker;
+typedef struct Linker Linker;
+
+// A merged global. label points into the object that defines it, or into an
+// arena copy once that object is dropped; it is not NUL-terminated in
+// general, so use length.
+struct SymbolTableEntry
+{
+    const char *label;
+    int length;
+    char location;
+    unsigned int offset;
+};
+
+// Every table is sized from the object file's header. text, data and the
+// symbol and relocation tables are object's own, read in place; object is
+// freed when the link is done with the file.
+struct FileData
+{
+    const char *name;
+    unsigned int textSize;
+    unsigned int dataSize;
+    unsigned int symbolTableSize;
+    unsigned int relocationTableSize;
+    unsigned int textStartingLine; // in final executable
+    unsigned int dataStartingLine; // in final executable
+    int *text;
+    int *data;
+    ObjectSymbol *symbolTable;
+    ObjectRelocation *relocTable;
+    ObjectFile object;
+    const char *bytes; // the object in memory, or NULL to read the file at name
+    size_t size;
+    unsigned int input;       // index of the object file or archive among the inputs
+    unsigned int firstGlobal; // the symbols the file defines, in the combined table
+    unsigned int numGlobals;
+    int *bindings; // what each symbol resolves to, set by bindSymbols
+};
+
+// Totals of the whole link and the merged symbols. Words are never copied
+// here; each file's words are relocated and written from its own buffer.
+struct CombinedFiles
+{
+    unsigned int textSize;
+    unsigned int dataSize;
+    unsigned int symbolTableSize;
+    unsigned int relocationTableSize;
+    SymbolTableEntry *symbolTable;
+};
+
+// Hashed index of the symbols merged into combinedFiles.symbolTable.
+// slots hold 1 + index into the table, 0 for empty, and numSlots is a power
+// of two at least twice the number of symbols that can be merged.
+struct GlobalTable
+{
+    SymbolTableEntry *symbols;
+    int *slots;
+    unsigned int numSlots;
+};
+
+// Every label in the symbol tables of the files linked so far, in the order
+// they first appear, and whether one of those files defines it. slots hold
+// 1 + index into labels, 0 for empty; numSlots is a power of two at least
+// twice the capacity.
+struct LabelSet
+{
+    char **labels;
+    bool *defined;
+    unsigned int size;
+    unsigned int capacity;
+    int *slots;
+    unsigned int numSlots;
+};
+
+// A word of the executable that was patched with the address of a global.
+struct RelocationSite
+{
+    unsigned int word;   // index in the executable
+    unsigned int global; // index in the combined symbol table
+    unsigned int file;
+};
+
+// A file of the last link. Its undefined labels are a run of the state's,
+// sorted by strcmp.
+struct StateFile
+{
+    unsigned int input;
+    unsigned int textSize;
+    unsigned int dataSize;
+    unsigned int textStartingLine;
+    unsigned int dataStartingLine;
+    unsigned int firstGlobal;
+    unsigned int numGlobals;
+    unsigned int firstUndefined;
+    unsigned int numUndefined;
+};
+
+// What the next link of the same executable needs to patch it: the inputs
+// as they were read, the layout, the labels each file left undefined, the
+// merged globals and the places they were written to. It is saved as
+//     char     magic[8]            "LC2KLNK\0"
+//     uint32   version             LINKSTATEVERSION
+//     uint32   numInputs, numFiles, numUndefined, numGlobals, numSites,
+//              textSize, dataSize
+//     uint64   output size, inode, seconds, nanoseconds
+//     inputs   { uint32 length; char name[length]; uint64 fingerprint[4]; }
+//     files    { uint32 input, textSize, dataSize, textStartingLine,
+//                dataStartingLine, firstGlobal, numGlobals, numUndefined; }
+//     undefined { uint32 length; char label[length]; }
+//     globals  { uint32 length; char label[length]; uint32 location, offset; }
+//     sites    { uint32 word, global, file; }
+// in little-endian fields.
+struct LinkState
+{
+    unsigned int numInputs;
+    const char **inputNames;
+    Fingerprint *inputs;
+    Fingerprint output;
+    unsigned int numFiles;
+    StateFile *files;
+    unsigned int numUndefined;
+    const char **undefined;
+    unsigned int textSize;
+    unsigned int dataSize;
+    unsigned int numGlobals;
+    SymbolTableEntry *globals;
+    unsigned int numSites;
+    RelocationSite *sites;
+};
+
+// Reads the fields of a saved link state up to its end. failed is set by
+// any read past the end.
+struct StateReader
+{
+    const char *next;
+    const char *end;
+    bool failed;
+};
+
+// Object files are handed out in order to whichever reader asks next.
+// results holds readObject's result for each file.
+struct ReadQueue
+{
+    FileData *files;
+    unsigned int numFiles;
+    int *results;
+    unsigned int next;
+    pthread_mutex_t lock;
+};
+
+struct ReadWorker
+{
+    ReadQueue *queue;
+    pthread_t thread;
+};
+
+// What one link holds until it returns, whichever way it does: its arena,
+// the archives it opened and the objects of its files. The layout, relocation
+// counts (by enum RelocationOpcode and target) and phase times are kept for
+// the report.
+struct Linker
+{
+    LinkJob *job;
+    Arena arena;
+    Archive *archives;
+    unsigned int numArchives;
+    FileData *files;
+    unsigned int numFiles;
+    CombinedFiles combinedFiles;
+    unsigned int relocations[3][NUMTARGETS];
+    double seconds[NUMPHASES];
+    struct timespec mark; // when the phase being timed started
+};
+
+static int initGlobalTable(GlobalTable *table, Arena *arena, SymbolTableEntry *symbols, unsigned int maxSymbols);
+static SymbolTableEntry *findGlobal(GlobalTable *table, const char *label, int length);
+static void addGlobal(GlobalTable *table, unsigned int index);
+static inline bool isLabel(const char *label, int length, const char *string);
+static int linkInputs(Linker *linker, OutputBuffer *out, LinkState *state);
+static int pullMembers(Linker *linker, FileData *files, unsigned int *numFiles, const char **archiveNames,
+                       unsigned int *archiveInputs, bool streaming);
+static int noteSymbols(LabelSet *set, FileData *file, Arena *arena);
+static int initStateFiles(LinkState *state, FileData *files, unsigned int numFiles, Arena *arena);
+static int sortUndefined(FileData *file, const char **labels, Arena *arena);
+static int noteUndefined(LinkState *state, unsigned int index, FileData *file, Arena *arena);
+static int relinkIncrementally(Linker *linker, const char *outFileStr, const char *stateFileStr, bool *relinked);
+static unsigned int collectSites(FileData *file, unsigned int index, CombinedFiles *combinedFiles,
+                                 RelocationSite *sites);
+static int saveLinkState(LinkJob *job, LinkState *state, const char *outFileStr, const char *stateFileStr);
+static int loadLinkState(LinkState *state, const char *stateFileStr, Arena *arena);
+static int writeWordsAt(int fd, unsigned int first, int *words, unsigned int count);
+static int patchWord(int fd, unsigned int index, unsigned int resolution);
+static int readFileData(FileData *file);
+static int readFileHeader(FileData *file);
+static void readFiles(FileData *files, unsigned int numFiles, int *results, Arena *arena);
+static int rereadFile(LinkJob *job, FileData *file);
+static int checkResult(LinkJob *job, int result, FileData *file);
+static int checkArchiveResult(LinkJob *job, int result, const char *path, unsigned int input);
+static int layoutFiles(FileData *files, unsigned int numFiles, CombinedFiles *combinedFiles, GlobalTable *globals,
+                       Arena *arena);
+static int mergeSymbols(LinkJob *job, CombinedFiles *combinedFiles, GlobalTable *globals, FileData *file,
+                        Arena *labels);
+static void logStartingLines(LinkJob *job, FileData *files, unsigned int numFiles);
+static int bindSymbols(FileData *file, GlobalTable *globals, Arena *arena);
+static int relocateFile(LinkJob *job, FileData *file, CombinedFiles *combinedFiles,
+                        unsigned int (*counts)[NUMTARGETS]);
+static void initLinker(Linker *linker, LinkJob *job);
+static void endPhase(Linker *linker, enum Phase phase);
+static void writeReport(Linker *linker, const char *outFileStr);
+static void writeJsonString(FILE *stream, const char *string, size_t length);
+static void writeWords(OutputBuffer *out, int *words, unsigned int count);
+
+// Records why the link failed, blaming input (-1 for none), and returns
+// status, so error paths read "return fail(job, ...)".
+static int
+fail(LinkJob *job, enum DiagnosticCode code, int status, int input, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    setDiagnosticV(&job->diagnostic, code, status, format, args);
+    va_end(args);
+    job->diagnostic.input = input;
+    return status;
+}
+
+// Fails because memory ran out, as the linker command does.
+static int
+failMemory(LinkJob *job)
+{
+    return fail(job, DIAGNOSTIC_MEMORY, 1, -1, "error: out of memory\n");
+}
+
+// Prints one of the progress lines of the linker command to job's log.
+static void
+logLine(LinkJob *job, const char *format, ...)
+{
+    if (job->log == NULL)
+        return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(job->log, format, args);
+    va_end(args);
+}
+
+static void
+initLinker(Linker *linker, LinkJob *job)
+{
+    memset(linker, 0, sizeof(*linker));
+    linker->job = job;
+    clock_gettime(CLOCK_MONOTONIC, &linker->mark);
+}
+
+// Adds the time since the mark to phase and moves the mark to now.
+static void
+endPhase(Linker *linker, enum Phase phase)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    linker->seconds[phase] += (now.tv_sec - linker->mark.tv_sec) + (now.tv_nsec - linker->mark.tv_nsec) / 1e9;
+    linker->mark = now;
+}
+
+// Frees the objects of the linker's files, which a later link may replace.
+static void
+releaseFiles(Linker *linker)
+{
+    for (unsigned int i = 0; i < linker->numFiles; ++i)
+        freeObject(&linker->files[i].object);
+    linker->numFiles = 0;
+}
+
+static void
+freeLinker(Linker *linker)
+{
+    releaseFiles(linker);
+    for (unsigned int i = 0; i < linker->numArchives; ++i)
+        freeArchive(&linker->archives[i]);
+    arenaFree(&linker->arena);
+}
+
+int linkObjects(LinkJob *job, OutputBuffer *out)
+{
+    clearDiagnostic(&job->diagnostic);
+    if (job->numInputs <= 0)
+        return fail(job, DIAGNOSTIC_NO_INPUTS, 1, -1, "error: no object files to link\n");
+    Linker linker;
+    initLinker(&linker, job);
+    int status = linkInputs(&linker, out, NULL);
+    if (status == 0 && job->report != NULL)
+        writeReport(&linker, NULL);
+    freeLinker(&linker);
+    return status;
+}
+
+int linkFile(LinkJob *job, const char *path)
+{
+    clearDiagnostic(&job->diagnostic);
+    if (job->numInputs <= 0)
+        return fail(job, DIAGNOSTIC_NO_INPUTS, 1, -1, "error: no object files to link\n");
+    Linker linker;
+    initLinker(&linker, job);
+    unsigned int numInputs = job->numInputs;
+    unsigned int i;
+    int status;
+
+    // changes are told by the inputs' fingerprints, so all must be files
+    bool incremental = job->incremental;
+    for (i = 0; i < numInputs; ++i)
+    {
+        if (job->inputs[i].bytes != NULL)
+            incremental = false;
+    }
+
+    char *stateFileStr = NULL;
+    LinkState state;
+    if (incremental)
+    {
+        stateFileStr = arenaAlloc(&linker.arena, strlen(path) + sizeof(LINKSTATESUFFIX));
+        if (stateFileStr == NULL)
+        {
+            freeLinker(&linker);
+            return failMemory(job);
+        }
+        strcpy(stateFileStr, path);
+        strcat(stateFileStr, LINKSTATESUFFIX);
+        // a report describes a full link; the next link may patch this one
+        bool relinked = false;
+        status = job->report == NULL ? relinkIncrementally(&linker, path, stateFileStr, &relinked) : 0;
+        if (status != 0 || relinked)
+        {
+            freeLinker(&linker);
+            return status;
+        }
+        // the full link reads again whatever the relink had read
+        releaseFiles(&linker);
+
+        // the inputs are fingerprinted before they are read, so that a file
+        // changing during the link is seen as changed by the next one
+        state.numInputs = numInputs;
+        state.inputNames = arenaAlloc(&linker.arena, numInputs * sizeof(char *));
+        state.inputs = arenaAlloc(&linker.arena, numInputs * sizeof(Fingerprint));
+        if (state.inputNames == NULL || state.inputs == NULL)
+        {
+            freeLinker(&linker);
+            return failMemory(job);
+        }
+        for (i = 0; i < numInputs; ++i)
+        {
+            state.inputNames[i] = job->inputs[i].name;
+            takeFingerprint(job->inputs[i].name, &state.inputs[i]);
+        }
+        remove(stateFileStr);
+    }
+
+    OutputBuffer out;
+    int opened = openOutput(&out, path);
+    if (opened != 0)
+    {
+        freeLinker(&linker);
+        if (opened == -2)
+            return failMemory(job);
+        return fail(job, DIAGNOSTIC_IO, 1, -1, "error in opening %s\n", path);
+    }
+    status = linkInputs(&linker, &out, incremental ? &state : NULL);
+    // a failed link leaves the executable empty, even once a streaming link
+    // has written part of it
+    if (status != 0)
+        discardOutput(&out);
+    if (closeOutput(&out) != 0 && status == 0)
+        status = fail(job, DIAGNOSTIC_IO, 1, -1, "error in writing %s\n", path);
+    endPhase(&linker, PHASE_WRITE);
+    if (status == 0 && incremental)
+        status = saveLinkState(job, &state, path, stateFileStr);
+    if (status == 0 && job->report != NULL)
+        writeReport(&linker, path);
+    freeLinker(&linker);
+    return status;
+}
+
+// Links the job's inputs into out. If state is not NULL, it is filled in with
+// everything but the inputs, for saveLinkState.
+static int
+linkInputs(Linker *linker, OutputBuffer *out, LinkState *state)
+{
+    LinkJob *job = linker->job;
+    Arena *arena = &linker->arena;
+    unsigned int numInputs = job->numInputs;
+    bool streaming = job->streaming;
+    unsigned int i;
+    int status;
+
+    // archives are told from object files by their magic and searched in input order
+    Archive *archives = arenaAlloc(arena, numInputs * sizeof(Archive));
+    const char **archiveNames = arenaAlloc(arena, numInputs * sizeof(char *));
+    unsigned int *archiveInputs = arenaAlloc(arena, numInputs * sizeof(unsigned int));
+    unsigned int *fileInputs = arenaAlloc(arena, numInputs * sizeof(unsigned int));
+    int *archiveResults = arenaAlloc(arena, numInputs * sizeof(int));
+    if (archives == NULL || archiveNames == NULL || archiveInputs == NULL || fileInputs == NULL ||
+        archiveResults == NULL)
+        return failMemory(job);
+    unsigned int numArchives = 0;
+    unsigned int numFiles = 0;
+    unsigned int maxFiles = 0;
+    linker->archives = archives;
+    for (i = 0; i < numInputs; ++i)
+    {
+        LinkInput *input = &job->inputs[i];
+        if (input->bytes != NULL ? !isArchiveBuffer(input->bytes, input->size) : !isArchiveFile(input->name))
+        {
+            fileInputs[numFiles++] = i;
+            continue;
+        }
+        archiveNames[numArchives] = input->name;
+        archiveInputs[numArchives] = i;
+        archiveResults[numArchives] = input->bytes != NULL
+                                          ? readArchiveBuffer(input->bytes, input->size, &archives[numArchives])
+                                          : readArchive(input->name, &archives[numArchives]);
+        maxFiles += archives[numArchives].memberCount;
+        linker->numArchives = ++numArchives;
+    }
+    maxFiles += numFiles;
+
+    // every file is zeroed so that the linker can free whichever objects were read
+    FileData *files = arenaAlloc(arena, (maxFiles + 1) * sizeof(FileData));
+    if (files == NULL)
+        return failMemory(job);
+    memset(files, 0, (maxFiles + 1) * sizeof(FileData));
+    linker->files = files;
+    linker->numFiles = maxFiles;
+    for (i = 0; i < numFiles; ++i)
+    {
+        LinkInput *input = &job->inputs[fileInputs[i]];
+        files[i].name = input->name;
+        files[i].bytes = input->bytes;
+        files[i].size = input->size;
+        files[i].input = fileInputs[i];
+    }
+
+    CombinedFiles combinedFiles;
+    GlobalTable globals;
+    RelocationSite *sites = NULL;
+    unsigned int numSites = 0;
+
+    if (!streaming)
+    {
+        // files are parsed concurrently; everything after that runs in input order
+        int *results = arenaAlloc(arena, (numFiles + 1) * sizeof(int));
+        if (results == NULL)
+            return failMemory(job);
+        if (numFiles)
+            readFiles(files, numFiles, results, arena);
+        for (i = 0; i < numFiles; ++i)
+        {
+            logLine(job, "opening %s\n", files[i].name);
+            if ((status = checkResult(job, results[i], &files[i])) != 0)
+                return status;
+        }
+        for (i = 0; i < numArchives; ++i)
+        {
+            logLine(job, "opening %s\n", archiveNames[i]);
+            if ((status = checkArchiveResult(job, archiveResults[i], archiveNames[i], archiveInputs[i])) != 0)
+                return status;
+        }
+        if ((status = pullMembers(linker, files, &numFiles, archiveNames, archiveInputs, false)) != 0)
+            return status;
+        endPhase(linker, PHASE_READ);
+
+        if (layoutFiles(files, numFiles, &combinedFiles, &globals, arena) != 0 ||
+            (state != NULL && initStateFiles(state, files, numFiles, arena) != 0))
+            return failMemory(job);
+        for (i = 0; i < numFiles; ++i)
+        {
+            if ((status = mergeSymbols(job, &combinedFiles, &globals, &files[i], NULL)) != 0)
+                return status;
+            if (state != NULL && noteUndefined(state, i, &files[i], arena) != 0)
+                return failMemory(job);
+        }
+        for (i = 0; i < numFiles; ++i)
+        {
+            if (bindSymbols(&files[i], &globals, arena) != 0)
+                return failMemory(job);
+        }
+        logStartingLines(job, files, numFiles);
+        if (state != NULL &&
+            (sites = arenaAlloc(arena, (combinedFiles.relocationTableSize + 1) * sizeof(RelocationSite))) == NULL)
+            return failMemory(job);
+        endPhase(linker, PHASE_MERGE);
+
+        // every file's words are relocated in place and written from its own buffer
+        for (i = 0; i < numFiles; ++i)
+        {
+            if ((status = relocateFile(job, &files[i], &combinedFiles, linker->relocations)) != 0)
+                return status;
+            if (state != NULL)
+                numSites += collectSites(&files[i], i, &combinedFiles, sites + numSites);
+        }
+        endPhase(linker, PHASE_RELOCATE);
+        for (i = 0; i < numFiles; ++i)
+            writeWords(out, files[i].text, files[i].textSize);
+        for (i = 0; i < numFiles; ++i)
+            writeWords(out, files[i].data, files[i].dataSize);
+        endPhase(linker, PHASE_WRITE);
+    }
+    else
+    {
+        // the layout only needs the headers
+        for (i = 0; i < numFiles; ++i)
+        {
+            logLine(job, "opening %s\n", files[i].name);
+            if ((status = checkResult(job, readFileHeader(&files[i]), &files[i])) != 0)
+                return status;
+        }
+        for (i = 0; i < numArchives; ++i)
+        {
+            logLine(job, "opening %s\n", archiveNames[i]);
+            if ((status = checkArchiveResult(job, archiveResults[i], archiveNames[i], archiveInputs[i])) != 0)
+                return status;
+        }
+        if ((status = pullMembers(linker, files, &numFiles, archiveNames, archiveInputs, true)) != 0)
+            return status;
+        endPhase(linker, PHASE_READ);
+        if (layoutFiles(files, numFiles, &combinedFiles, &globals, arena) != 0 ||
+            (state != NULL && initStateFiles(state, files, numFiles, arena) != 0))
+            return failMemory(job);
+
+        // Each later pass reads one file at a time and drops its object, and
+        // its bindings in scratch, before the next: first the symbols, then
+        // the relocated text of every file, then the relocated data. The
+        // phases interleave, so each step is timed as it finishes.
+        Arena scratch = {NULL};
+        for (i = 0; i < numFiles && status == 0; ++i)
+        {
+            status = rereadFile(job, &files[i]);
+            endPhase(linker, PHASE_READ);
+            if (status == 0)
+                status = mergeSymbols(job, &combinedFiles, &globals, &files[i], arena);
+            if (status == 0 && state != NULL && noteUndefined(state, i, &files[i], arena) != 0)
+                status = failMemory(job);
+            freeObject(&files[i].object);
+            endPhase(linker, PHASE_MERGE);
+        }
+        if (status != 0)
+            return status;
+        logStartingLines(job, files, numFiles);
+        if (state != NULL &&
+            (sites = arenaAlloc(arena, (combinedFiles.relocationTableSize + 1) * sizeof(RelocationSite))) == NULL)
+            return failMemory(job);
+
+        // the text pass counts the relocations, which the data pass repeats;
+        // each rereads the symbols, so each binds them again
+        for (i = 0; i < numFiles && status == 0; ++i)
+        {
+            status = rereadFile(job, &files[i]);
+            endPhase(linker, PHASE_READ);
+            if (status == 0)
+                status = bindSymbols(&files[i], &globals, &scratch) != 0
+                             ? failMemory(job)
+                             : relocateFile(job, &files[i], &combinedFiles, linker->relocations);
+            if (status == 0 && state != NULL)
+                numSites += collectSites(&files[i], i, &combinedFiles, sites + numSites);
+            endPhase(linker, PHASE_RELOCATE);
+            if (status == 0)
+                writeWords(out, files[i].text, files[i].textSize);
+            freeObject(&files[i].object);
+            arenaFree(&scratch);
+            endPhase(linker, PHASE_WRITE);
+        }
+        for (i = 0; i < numFiles && status == 0; ++i)
+        {
+            status = rereadFile(job, &files[i]);
+            endPhase(linker, PHASE_READ);
+            if (status == 0)
+                status = bindSymbols(&files[i], &globals, &scratch) != 0
+                             ? failMemory(job)
+                             : relocateFile(job, &files[i], &combinedFiles, NULL);
+            endPhase(linker, PHASE_RELOCATE);
+            if (status == 0)
+                writeWords(out, files[i].data, files[i].dataSize);
+            freeObject(&files[i].object);
+            arenaFree(&scratch);
+            endPhase(linker, PHASE_WRITE);
+        }
+        if (status != 0)
+            return status;
+    }
+
+    linker->numFiles = numFiles;
+    linker->combinedFiles = combinedFiles;
+
+    if (state != NULL)
+    {
+        for (i = 0; i < numFiles; ++i)
+        {
+            StateFile *file = &state->files[i];
+            file->input = files[i].input;
+            file->textSize = files[i].textSize;
+            file->dataSize = files[i].dataSize;
+            file->textStartingLine = files[i].textStartingLine;
+            file->dataStartingLine = files[i].dataStartingLine;
+            file->firstGlobal = files[i].firstGlobal;
+            file->numGlobals = files[i].numGlobals;
+        }
+        state->textSize = combinedFiles.textSize;
+        state->dataSize = combinedFiles.dataSize;
+        state->numGlobals = combinedFiles.symbolTableSize;
+        state->globals = combinedFiles.symbolTable;
+        state->numSites = numSites;
+        state->sites = sites;
+    }
+    return 0;
+}
+
+// Sets up state's files for a link of files, whose sizes are known; the
+// rest of each is filled in as the link goes. Returns 0, or -1 if memory
+// ran out.
+static int
+initStateFiles(LinkState *state, FileData *files, unsigned int numFiles, Arena *arena)
+{
+    unsigned int maxUndefined = 0;
+    for (unsigned int i = 0; i < numFiles; ++i)
+        maxUndefined += files[i].symbolTableSize;
+    state->numFiles = numFiles;
+    state->files = arenaAlloc(arena, (numFiles + 1) * sizeof(StateFile));
+    state->numUndefined = 0;
+    state->undefined = arenaAlloc(arena, (maxUndefined + 1) * sizeof(char *));
+    return state->files == NULL || state->undefined == NULL ? -1 : 0;
+}
+
+static int
+compareLabels(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Copies the labels file leaves undefined to labels, sorted, and returns
+// how many there are, or -1 if memory ran out.
+static int
+sortUndefined(FileData *file, const char **labels, Arena *arena)
+{
+    int count = 0;
+    for (unsigned int j = 0; j < file->symbolTableSize; ++j)
+    {
+        ObjectSymbol *symbol = &file->symbolTable[j];
+        if (symbol->area == 'U' && (labels[count++] = arenaString(arena, symbol->label, symbol->length)) == NULL)
+            return -1;
+    }
+    qsort(labels, count, sizeof(char *), compareLabels);
+    return count;
+}
+
+// Records the labels file, the index-th of the link, leaves undefined. They
+// are what it asked the archives for, so the next link can patch it only if
+// they stay the same. Returns 0, or -1 if memory ran out.
+static int
+noteUndefined(LinkState *state, unsigned int index, FileData *file, Arena *arena)
+{
+    StateFile *saved = &state->files[index];
+    int count = sortUndefined(file, state->undefined + state->numUndefined, arena);
+    if (count < 0)
+        return -1;
+    saved->firstUndefined = state->numUndefined;
+    saved->numUndefined = count;
+    state->numUndefined += count;
+    return 0;
+}
+
+// Fails with the linker's message if readObject did not return 0 for file.
+static int
+checkResult(LinkJob *job, int result, FileData *file)
+{
+    // text and binary objects are told apart by the binary magic
+    if (result == -1)
+        return fail(job, DIAGNOSTIC_IO, 1, file->input, "error in opening %s\n", file->name);
+    if (result == -3)
+        return failMemory(job);
+    if (result != 0)
+        return fail(job, DIAGNOSTIC_INVALID_OBJECT, 1, file->input, "error: %s is not a valid object file\n",
+                    file->name);
+    return 0;
+}
+
+// Fails with the linker's message if readArchive did not return 0 for path.
+static int
+checkArchiveResult(LinkJob *job, int result, const char *path, unsigned int input)
+{
+    if (result == -1)
+        return fail(job, DIAGNOSTIC_IO, 1, input, "error in opening %s\n", path);
+    if (result == -3)
+        return failMemory(job);
+    if (result != 0)
+        return fail(job, DIAGNOSTIC_INVALID_OBJECT, 1, input, "error: %s is not a valid archive\n", path);
+    return 0;
+}
+
+// Appends to files the archive members needed to define the labels that the
+// files are left without, reading each as it is pulled in. A label is looked
+// up in the archives in command-line order; a member pulled in may leave
+// labels of its own undefined, which are searched for in turn. Members no
+// label asks for are never parsed. In streaming mode the files hold only
+// their headers, so their symbols are read again here, and members keep only
+// their table sizes. numFiles is updated as members are appended.
+static int
+pullMembers(Linker *linker, FileData *files, unsigned int *numFiles, const char **archiveNames,
+            unsigned int *archiveInputs, bool streaming)
+{
+    LinkJob *job = linker->job;
+    Arena *arena = &linker->arena;
+    Archive *archives = linker->archives;
+    unsigned int numArchives = linker->numArchives;
+    if (numArchives == 0)
+        return 0;
+
+    LabelSet set = {NULL, NULL, 0, 0, NULL, 0};
+    for (unsigned int i = 0; i < *numFiles; ++i)
+    {
+        int status = streaming ? rereadFile(job, &files[i]) : 0;
+        if (status == 0 && noteSymbols(&set, &files[i], arena) != 0)
+            status = failMemory(job);
+        if (streaming)
+            freeObject(&files[i].object);
+        if (status != 0)
+            return status;
+    }
+
+    bool **pulled = arenaAlloc(arena, numArchives * sizeof(bool *));
+    if (pulled == NULL)
+        return failMemory(job);
+    for (unsigned int i = 0; i < numArchives; ++i)
+    {
+        if ((pulled[i] = arenaAlloc(arena, archives[i].memberCount + 1)) == NULL)
+            return failMemory(job);
+        memset(pulled[i], 0, archives[i].memberCount + 1);
+    }
+
+    // labels noted by members pulled in are appended and reached by this loop
+    for (unsigned int j = 0; j < set.size; ++j)
+    {
+        if (set.defined[j] || !strcmp(set.labels[j], "Stack"))
+            continue;
+        for (unsigned int i = 0; i < numArchives; ++i)
+        {
+            int member = findArchiveSymbol(&archives[i], set.labels[j]);
+            if (member < 0 || pulled[i][member])
+                continue;
+            pulled[i][member] = true;
+
+            FileData *file = &files[*numFiles];
+            ArchiveMember *source = &archives[i].members[member];
+            size_t length = strlen(archiveNames[i]) + strlen(source->name) + 3;
+            char *name = arenaAlloc(arena, length);
+            if (name == NULL)
+                return failMemory(job);
+            snprintf(name, length, "%s(%s)", archiveNames[i], source->name);
+            file->name = name;
+            file->bytes = source->bytes;
+            file->size = source->size;
+            file->input = archiveInputs[i];
+            logLine(job, "opening %s\n", file->name);
+            int status = checkResult(job, readFileData(file), file);
+            if (status == 0 && noteSymbols(&set, file, arena) != 0)
+                status = failMemory(job);
+            if (streaming)
+                freeObject(&file->object);
+            if (status != 0)
+                return status;
+            ++*numFiles;
+            break;
+        }
+    }
+    return 0;
+}
+
+// Adds the labels in file's symbol table to set, copying new ones into arena.
+// Returns 0, or -1 if memory ran out.
+static int
+noteSymbols(LabelSet *set, FileData *file, Arena *arena)
+{
+    for (unsigned int j = 0; j < file->symbolTableSize; ++j)
+    {
+        const char *label = file->symbolTable[j].label;
+        int length = file->symbolTable[j].length;
+        if (2 * (set->size + 1) > set->numSlots)
+        {
+            // grow the arrays and rehash; the old ones stay in the arena
+            unsigned int capacity = set->capacity ? 2 * set->capacity : INITIALLABELS;
+            char **labels = arenaAlloc(arena, capacity * sizeof(char *));
+            bool *defined = arenaAlloc(arena, capacity * sizeof(bool));
+            int *slots = arenaAlloc(arena, 2 * capacity * sizeof(int));
+            if (labels == NULL || defined == NULL || slots == NULL)
+                return -1;
+            if (set->size)
+            {
+                memcpy(labels, set->labels, set->size * sizeof(char *));
+                memcpy(defined, set->defined, set->size * sizeof(bool));
+            }
+            set->labels = labels;
+            set->defined = defined;
+            set->capacity = capacity;
+            set->numSlots = 2 * capacity;
+            set->slots = slots;
+            memset(set->slots, 0, set->numSlots * sizeof(int));
+            for (unsigned int k = 0; k < set->size; ++k)
+            {
+                unsigned int slot = hashLabel(set->labels[k], strlen(set->labels[k])) & (set->numSlots - 1);
+                while (set->slots[slot])
+                    slot = (slot + 1) & (set->numSlots - 1);
+                set->slots[slot] = k + 1;
+            }
+        }
+
+        unsigned int slot = hashLabel(label, length) & (set->numSlots - 1);
+        while (set->slots[slot] && !isLabel(label, length, set->labels[set->slots[slot] - 1]))
+            slot = (slot + 1) & (set->numSlots - 1);
+        if (!set->slots[slot])
+        {
+            if ((set->labels[set->size] = arenaString(arena, label, length)) == NULL)
+                return -1;
+            set->defined[set->size] = false;
+            set->slots[slot] = ++set->size;
+        }
+        if (file->symbolTable[j].area != 'U')
+            set->defined[set->slots[slot] - 1] = true;
+    }
+    return 0;
+}
+
+// Assigns every file its place in the final executable from the table sizes
+// alone, and sets up the combined symbol table and its index. Returns 0, or
+// -1 if memory ran out.
+static int
+layoutFiles(FileData *files, unsigned int numFiles, CombinedFiles *combinedFiles, GlobalTable *globals,
+            Arena *arena)
+{
+    // initializations
+    combinedFiles->textSize = 0;
+    combinedFiles->dataSize = 0;
+    combinedFiles->symbolTableSize = 0;
+    combinedFiles->relocationTableSize = 0;
+
+    unsigned int maxSymbols = 0;
+    for (int i = 0; i < numFiles; ++i)
+    {
+        files[i].textStartingLine = combinedFiles->textSize; // offset for the text section
+        files[i].dataStartingLine = combinedFiles->dataSize; // offset for the data section
+        combinedFiles->textSize += files[i].textSize;
+        combinedFiles->dataSize += files[i].dataSize;
+        combinedFiles->relocationTableSize += files[i].relocationTableSize;
+        maxSymbols += files[i].symbolTableSize;
+    }
+    // combinedFiles->textSize now is the dataStartingLine in final executable
+    combinedFiles->symbolTable = arenaAlloc(arena, maxSymbols * sizeof(SymbolTableEntry));
+    if (combinedFiles->symbolTable == NULL)
+        return -1;
+    return initGlobalTable(globals, arena, combinedFiles->symbolTable, maxSymbols);
+}
+
+// Adds the symbols file defines to the combined symbol table, where offset
+// contains absolute location in text / data section. Labels are copied into
+// labels unless it is NULL, in which case file's object must outlive them.
+static int
+mergeSymbols(LinkJob *job, CombinedFiles *combinedFiles, GlobalTable *globals, FileData *file, Arena *labels)
+{
+    file->firstGlobal = combinedFiles->symbolTableSize;
+    for (int j = 0; j < file->symbolTableSize; ++j)
+    {
+        ObjectSymbol *entry = &file->symbolTable[j];
+        // if the label is undefined, we don't add it to the total symbol table
+        if (entry->area == 'U')
+            continue;
+
+        if (isLabel(entry->label, entry->length, "Stack"))
+            return fail(job, DIAGNOSTIC_LOCAL_STACK, 1, file->input, "Local definition of Stack is not allowed\n");
+        // if we reach here, it is not a previously defined global label
+        // look it up among the labels merged so far to detect duplicate definition
+        if (findGlobal(globals, entry->label, entry->length) != NULL)
+            return fail(job, DIAGNOSTIC_DUPLICATE_GLOBAL, 1, file->input, "Duplicate definition of global label\n");
+
+        // if we reach here, we are appending the new label to combinedFiles symbol table
+        SymbolTableEntry *symbol = &combinedFiles->symbolTable[combinedFiles->symbolTableSize];
+        symbol->label = labels != NULL ? arenaString(labels, entry->label, entry->length) : entry->label;
+        if (symbol->label == NULL)
+            return failMemory(job);
+        symbol->length = entry->length;
+        symbol->location = entry->area;
+        symbol->offset = entry->offset;
+        if (symbol->location == 'T')
+        {
+            symbol->offset = file->textStartingLine + file->symbolTable[j].offset;
+        }
+        else if (symbol->location == 'D')
+        {
+            // offset in symbol table is the absolute offset for text + data
+            symbol->offset = combinedFiles->textSize + file->dataStartingLine + file->symbolTable[j].offset;
+        }
+        addGlobal(globals, combinedFiles->symbolTableSize);
+        ++combinedFiles->symbolTableSize;
+    }
+    file->numGlobals = combinedFiles->symbolTableSize - file->firstGlobal;
+    return 0;
+}
+
+// Binds every symbol of file, by label, to the merged global of that label,
+// Stack or nothing, so that relocations are resolved by index alone. Runs
+// once all files are merged. Returns 0, or -1 if memory ran out.
+static int
+bindSymbols(FileData *file, GlobalTable *globals, Arena *arena)
+{
+    file->bindings = arenaAlloc(arena, (file->symbolTableSize + 1) * sizeof(int));
+    if (file->bindings == NULL)
+        return -1;
+    for (int j = 0; j < file->symbolTableSize; ++j)
+    {
+        ObjectSymbol *entry = &file->symbolTable[j];
+        SymbolTableEntry *symbol = findGlobal(globals, entry->label, entry->length);
+        if (symbol != NULL)
+            file->bindings[j] = symbol - globals->symbols;
+        else
+            file->bindings[j] = isLabel(entry->label, entry->length, "Stack") ? BINDSTACK : BINDUNDEFINED;
+    }
+    return 0;
+}
+
+static void
+logStartingLines(LinkJob *job, FileData *files, unsigned int numFiles)
+{
+    for (int i = 0; i < numFiles; ++i)
+    {
+        logLine(job, "File %d: Text Starting Line = %d\n", i, files[i].textStartingLine);
+    }
+}
+
+// Writes the report of a successful link to job->report: the layout of the
+// executable outFileStr (NULL if it is not a file), the address of every
+// global, the relocations by opcode and target, and the phase times.
+// Addresses are executable lines; a module's ranges are [start, end).
+static void
+writeReport(Linker *linker, const char *outFileStr)
+{
+    FILE *report = linker->job->report;
+    CombinedFiles *combinedFiles = &linker->combinedFiles;
+    unsigned int i;
+
+    fprintf(report, "{\n  \"output\": ");
+    if (outFileStr != NULL)
+        writeJsonString(report, outFileStr, strlen(outFileStr));
+    else
+        fprintf(report, "null");
+    fprintf(report, ",\n  \"textSize\": %u,\n  \"dataSize\": %u,\n  \"stack\": %u,\n", combinedFiles->textSize,
+            combinedFiles->dataSize, combinedFiles->textSize + combinedFiles->dataSize);
+
+    fprintf(report, "  \"modules\": [");
+    for (i = 0; i < linker->numFiles; ++i)
+    {
+        FileData *file = &linker->files[i];
+        unsigned int dataStart = combinedFiles->textSize + file->dataStartingLine;
+        fprintf(report, "%s\n    {\"name\": ", i ? "," : "");
+        writeJsonString(report, file->name, strlen(file->name));
+        fprintf(report, ", \"input\": %u, \"text\": [%u, %u], \"data\": [%u, %u]}", file->input,
+                file->textStartingLine, file->textStartingLine + file->textSize, dataStart,
+                dataStart + file->dataSize);
+    }
+    fprintf(report, "%s],\n", linker->numFiles ? "\n  " : "");
+
+    // each file's globals are a run of the combined table
+    fprintf(report, "  \"globals\": [");
+    bool first = true;
+    for (i = 0; i < linker->numFiles; ++i)
+    {
+        FileData *file = &linker->files[i];
+        for (unsigned int j = file->firstGlobal; j < file->firstGlobal + file->numGlobals; ++j)
+        {
+            SymbolTableEntry *symbol = &combinedFiles->symbolTable[j];
+            fprintf(report, "%s\n    {\"label\": ", first ? "" : ",");
+            writeJsonString(report, symbol->label, symbol->length);
+            fprintf(report, ", \"address\": %u, \"section\": \"%s\", \"module\": %u}", symbol->offset,
+                    symbol->location == 'T' ? "text" : "data", i);
+            first = false;
+        }
+    }
+    fprintf(report, "%s],\n", first ? "" : "\n  ");
+
+    fprintf(report, "  \"relocations\": {");
+    for (int opcode = 0; opcode < 3; ++opcode)
+    {
+        fprintf(report, "%s\n    \"%s\": {", opcode ? "," : "", relocationOpcodeNames[opcode]);
+        for (int target = 0; target < NUMTARGETS; ++target)
+            fprintf(report, "%s\"%s\": %u", target ? ", " : "", targetNames[target],
+                    linker->relocations[opcode][target]);
+        fprintf(report, "}");
+    }
+    fprintf(report, "\n  },\n");
+
+    double total = 0;
+    fprintf(report, "  \"seconds\": {");
+    for (int phase = 0; phase < NUMPHASES; ++phase)
+    {
+        fprintf(report, "\"%s\": %.6f, ", phaseNames[phase], linker->seconds[phase]);
+        total += linker->seconds[phase];
+    }
+    fprintf(report, "\"total\": %.6f}\n}\n", total);
+}
+
+static void
+writeJsonString(FILE *stream, const char *string, size_t length)
+{
+    putc('"', stream);
+    for (const unsigned char *c = (const unsigned char *)string; c < (const unsigned char *)string + length; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(stream, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(stream, "\\u%04x", *c);
+        else
+            putc(*c, stream);
+    }
+    putc('"', stream);
+}
+
+// Resolves every relocation of file against the consolidated symbol table and
+// patches its own text and data.
+// For global labels, we change the offset to the address of the global the
+// relocation's symbol is bound to, remembering to deal with Stack. For local
+// labels, we locate the label's range in the executable by the file's
+// starting lines and sizes (both text and data).
+static int
+relocateFile(LinkJob *job, FileData *file, CombinedFiles *combinedFiles, unsigned int (*counts)[NUMTARGETS])
+{
+    for (int i = 0; i < file->relocationTableSize; ++i)
+    {
+        ObjectRelocation *relocation = &file->relocTable[i];
+        unsigned int relocOffset = relocation->offset;
+        int fromText = relocation->section == SECTION_TEXT;
+
+        // a relocation outside its own section would patch another file's words
+        if (relocOffset >= (fromText ? file->textSize : file->dataSize))
+            return fail(job, DIAGNOSTIC_RELOCATION_RANGE, 1, file->input,
+                        "error: relocation offset %u is outside its section in %s\n", relocOffset, file->name);
+        int *target = fromText ? &file->text[relocOffset] : &file->data[relocOffset];
+        int instruction = *target;
+
+        int resolution; // this records the correct offset to resolve
+        enum RelocationTarget kind = TARGET_LOCAL;
+        // if the label is global
+        if (relocation->symbol != OBJECTLOCAL)
+        {
+            int binding = file->bindings[relocation->symbol];
+            kind = binding >= 0 ? TARGET_GLOBAL : TARGET_STACK;
+            if (binding >= 0)
+                resolution = combinedFiles->symbolTable[binding].offset;
+            else
+            {
+                if (binding == BINDSTACK)
+                    resolution = combinedFiles->textSize + combinedFiles->dataSize;
+                else
+                    return fail(job, DIAGNOSTIC_UNDEFINED_LABEL, 1, file->input, "Undefined label\n%.*s\n",
+                                file->symbolTable[relocation->symbol].length,
+                                file->symbolTable[relocation->symbol].label);
+            }
+        }
+        else
+        {
+            // check the label is from text or data by comparing offset with file's textSize
+            // TODO: write test on edge case where original offset equals textSize
+            int offset = instruction & 0xFFFF;
+            if (offset >= file->textSize + file->dataSize)
+                return fail(job, DIAGNOSTIC_RELOCATION_RANGE, -1, file->input,
+                            "out of range label, possibly wrong instruction\n0x%08X\n", instruction);
+            if (offset < file->textSize)
+            {
+                // the label is in text section
+                resolution = file->textStartingLine + offset;
+            }
+            else
+            {
+                resolution = combinedFiles->textSize + file->dataStartingLine - file->textSize + offset;
+            }
+        }
+
+        *target = *target & 0xFFFF0000; // Set the lower 16 bits to zero
+        *target += resolution;
+
+        if (counts != NULL)
+            ++counts[relocation->opcode][kind];
+    }
+    return 0;
+}
+
+/* writeHex prints a machine code word / number in the proper hex
+   format into the output buffer, which is flushed in large chunks */
+static void
+writeWords(OutputBuffer *out, int *words, unsigned int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        writeHex(out, words[i]);
+    }
+}
+
+// Records where file's relocations wrote the address of a global, other
+// than Stack, which only moves when the sizes of the link change.
+static unsigned int
+collectSites(FileData *file, unsigned int index, CombinedFiles *combinedFiles, RelocationSite *sites)
+{
+    unsigned int count = 0;
+    for (int i = 0; i < file->relocationTableSize; ++i)
+    {
+        ObjectRelocation *relocation = &file->relocTable[i];
+        if (relocation->symbol == OBJECTLOCAL || file->bindings[relocation->symbol] < 0)
+            continue;
+        if (relocation->section == SECTION_TEXT)
+            sites[count].word = file->textStartingLine + relocation->offset;
+        else
+            sites[count].word = combinedFiles->textSize + file->dataStartingLine + relocation->offset;
+        sites[count].global = file->bindings[relocation->symbol];
+        sites[count].file = index;
+        ++count;
+    }
+    return count;
+}
+
+// Relinks from the state saved by the previous link of outFileStr if every
+// object file that changed since can be patched into the executable: it
+// must keep its text and data sizes, define the same globals and leave the
+// same labels undefined, and every global it uses must still be defined.
+// Its words are relocated and written over the old ones, and so are the
+// words of other files that use a global it moved. relinked is left false,
+// with nothing written, if a full link is needed. Returns 0 unless patching
+// the executable failed.
+static int
+relinkIncrementally(Linker *linker, const char *outFileStr, const char *stateFileStr, bool *relinked)
+{
+    LinkJob *job = linker->job;
+    Arena *arena = &linker->arena;
+    LinkInput *inputs = job->inputs;
+    LinkState state;
+    Fingerprint output;
+    if (loadLinkState(&state, stateFileStr, arena) != 0 || state.numInputs != job->numInputs ||
+        takeFingerprint(outFileStr, &output) != 0 || memcmp(&output, &state.output, sizeof(output)) ||
+        output.size != (uint64_t)WORDWIDTH * (state.textSize + state.dataSize))
+        return 0;
+
+    // an archive that changed may now supply other members
+    bool *changed = arenaAlloc(arena, state.numInputs + 1);
+    if (changed == NULL)
+        return failMemory(job);
+    for (unsigned int i = 0; i < state.numInputs; ++i)
+    {
+        Fingerprint now;
+        if (strcmp(inputs[i].name, state.inputNames[i]) || takeFingerprint(inputs[i].name, &now) != 0)
+            return 0;
+        changed[i] = memcmp(&now, &state.inputs[i], sizeof(now)) != 0;
+        if (changed[i] && isArchiveFile(inputs[i].name))
+            return 0;
+        state.inputs[i] = now;
+    }
+
+    GlobalTable globals;
+    if (initGlobalTable(&globals, arena, state.globals, state.numGlobals) != 0)
+        return failMemory(job);
+    for (unsigned int i = 0; i < state.numGlobals; ++i)
+        addGlobal(&globals, i);
+    CombinedFiles combinedFiles = {state.textSize, state.dataSize, state.numGlobals, 0, state.globals};
+
+    FileData *files = arenaAlloc(arena, (state.numFiles + 1) * sizeof(FileData));
+    unsigned int *indices = arenaAlloc(arena, (state.numFiles + 1) * sizeof(unsigned int));
+    bool *moved = arenaAlloc(arena, state.numGlobals + 1);
+    bool *defined = arenaAlloc(arena, state.numGlobals + 1);
+    bool *rewritten = arenaAlloc(arena, state.numFiles + 1);
+    if (files == NULL || indices == NULL || moved == NULL || defined == NULL || rewritten == NULL)
+        return failMemory(job);
+    memset(files, 0, (state.numFiles + 1) * sizeof(FileData));
+    linker->files = files;
+    memset(moved, 0, state.numGlobals + 1);
+    memset(defined, 0, state.numGlobals + 1);
+    unsigned int numFiles = 0;
+    unsigned int maxSites = state.numSites;
+    for (unsigned int i = 0; i < state.numFiles; ++i)
+    {
+        StateFile *saved = &state.files[i];
+        if (!changed[saved->input])
+            continue;
+        FileData *file = &files[numFiles];
+        file->name = inputs[saved->input].name;
+        file->bytes = NULL;
+        linker->numFiles = numFiles + 1;
+        if (readFileData(file) != 0 || file->textSize != saved->textSize ||
+            file->dataSize != saved->dataSize)
+            return 0;
+        file->textStartingLine = saved->textStartingLine;
+        file->dataStartingLine = saved->dataStartingLine;
+        file->input = saved->input;
+        file->firstGlobal = saved->firstGlobal;
+        file->numGlobals = saved->numGlobals;
+
+        // a file that asks for other labels may need other archive members,
+        // or no longer need some of those the last link pulled in
+        const char **undefined = arenaAlloc(arena, (file->symbolTableSize + 1) * sizeof(char *));
+        int numUndefined = undefined != NULL ? sortUndefined(file, undefined, arena) : -1;
+        if (numUndefined < 0)
+            return failMemory(job);
+        if ((unsigned int)numUndefined != saved->numUndefined)
+            return 0;
+        for (unsigned int j = 0; j < saved->numUndefined; ++j)
+        {
+            if (strcmp(undefined[j], state.undefined[saved->firstUndefined + j]))
+                return 0;
+        }
+
+        // every global keeps its slot in the table; only its address may move
+        unsigned int numDefined = 0;
+        for (int j = 0; j < file->symbolTableSize; ++j)
+        {
+            ObjectSymbol *entry = &file->symbolTable[j];
+            if (entry->area == 'U')
+                continue;
+            SymbolTableEntry *symbol = findGlobal(&globals, entry->label, entry->length);
+            if (symbol == NULL)
+                return 0;
+            unsigned int global = symbol - state.globals;
+            if (global < saved->firstGlobal || global >= saved->firstGlobal + saved->numGlobals ||
+                defined[global] || entry->area != symbol->location)
+                return 0;
+            defined[global] = true;
+            ++numDefined;
+            unsigned int offset = entry->area == 'T' ? saved->textStartingLine + entry->offset
+                                                         : state.textSize + saved->dataStartingLine + entry->offset;
+            if (offset != symbol->offset)
+            {
+                symbol->offset = offset;
+                moved[global] = true;
+            }
+        }
+        if (numDefined != saved->numGlobals)
+            return 0;
+        indices[numFiles++] = i;
+        maxSites += file->relocationTableSize;
+    }
+
+    // a global used but no longer defined is reported by the full link
+    for (unsigned int i = 0; i < numFiles; ++i)
+    {
+        if (bindSymbols(&files[i], &globals, arena) != 0)
+            return failMemory(job);
+        for (int j = 0; j < files[i].relocationTableSize; ++j)
+        {
+            unsigned int symbol = files[i].relocTable[j].symbol;
+            if (symbol != OBJECTLOCAL && files[i].bindings[symbol] == BINDUNDEFINED)
+                return 0;
+        }
+    }
+
+    for (unsigned int i = 0; i < numFiles; ++i)
+        logLine(job, "opening %s\n", files[i].name);
+    for (unsigned int i = 0; i < state.numFiles; ++i)
+        logLine(job, "File %d: Text Starting Line = %d\n", i, state.files[i].textStartingLine);
+    RelocationSite *sites = arenaAlloc(arena, (maxSites + 1) * sizeof(RelocationSite));
+    if (sites == NULL)
+        return failMemory(job);
+
+    // if patching fails part way, the next link is a full one
+    *relinked = true;
+    remove(stateFileStr);
+    int fd = open(outFileStr, O_RDWR);
+    if (fd < 0)
+        return fail(job, DIAGNOSTIC_IO, 1, -1, "error in opening %s\n", outFileStr);
+
+    memset(rewritten, 0, state.numFiles + 1);
+    for (unsigned int i = 0; i < numFiles; ++i)
+        rewritten[indices[i]] = true;
+    bool failed = false;
+    unsigned int numSites = 0;
+    for (unsigned int i = 0; i < state.numSites; ++i)
+    {
+        RelocationSite *site = &state.sites[i];
+        if (rewritten[site->file])
+            continue;
+        if (moved[site->global] && patchWord(fd, site->word, state.globals[site->global].offset) != 0)
+            failed = true;
+        sites[numSites++] = *site;
+    }
+    for (unsigned int i = 0; i < numFiles; ++i)
+    {
+        FileData *file = &files[i];
+        int status = relocateFile(job, file, &combinedFiles, NULL);
+        if (status != 0)
+        {
+            close(fd);
+            return status;
+        }
+        if (writeWordsAt(fd, file->textStartingLine, file->text, file->textSize) != 0 ||
+            writeWordsAt(fd, state.textSize + file->dataStartingLine, file->data, file->dataSize) != 0)
+            failed = true;
+        numSites += collectSites(file, indices[i], &combinedFiles, sites + numSites);
+    }
+    if (close(fd) != 0 || failed)
+        return fail(job, DIAGNOSTIC_IO, 1, -1, "error in writing %s\n", outFileStr);
+
+    state.numSites = numSites;
+    state.sites = sites;
+    return saveLinkState(job, &state, outFileStr, stateFileStr);
+}
+
+// Writes count bytes at offset of the file, retrying short writes.
+static int
+writeAt(int fd, const char *bytes, size_t count, off_t offset)
+{
+    while (count > 0)
+    {
+        ssize_t written = pwrite(fd, bytes, count, offset);
+        if (written <= 0)
+            return -1;
+        bytes += written;
+        count -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+// Overwrites count words of the executable open as fd, starting at word
+// first, PATCHCHUNK words at a time.
+static int
+writeWordsAt(int fd, unsigned int first, int *words, unsigned int count)
+{
+    char text[PATCHCHUNK * WORDWIDTH + 1];
+    for (unsigned int done = 0; done < count; done += PATCHCHUNK)
+    {
+        unsigned int chunk = count - done < PATCHCHUNK ? count - done : PATCHCHUNK;
+        for (unsigned int i = 0; i < chunk; ++i)
+            snprintf(text + (size_t)i * WORDWIDTH, WORDWIDTH + 1, "0x%08X\n", words[done + i]);
+        if (writeAt(fd, text, (size_t)chunk * WORDWIDTH, (off_t)(first + done) * WORDWIDTH) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Replaces the lower 16 bits of word index of the executable open as fd
+// with resolution, as relocateFile does.
+static int
+patchWord(int fd, unsigned int index, unsigned int resolution)
+{
+    char text[WORDWIDTH + 1];
+    off_t offset = (off_t)index * WORDWIDTH;
+    if (pread(fd, text, WORDWIDTH, offset) != WORDWIDTH || text[0] != '0' || text[1] != 'x' ||
+        text[WORDWIDTH - 1] != '\n')
+        return -1;
+    text[WORDWIDTH - 1] = '\0';
+    int word = (int)strtoul(text + 2, NULL, 16);
+    word = (word & 0xFFFF0000) + resolution;
+    snprintf(text, sizeof(text), "0x%08X\n", word);
+    return writeAt(fd, text, WORDWIDTH, offset);
+}
+
+static void
+writeStateFingerprint(OutputBuffer *out, Fingerprint *fingerprint)
+{
+    uint64_t fields[4] = {fingerprint->size, fingerprint->inode, fingerprint->seconds, fingerprint->nanoseconds};
+    for (int i = 0; i < 4; ++i)
+    {
+        writeWord(out, fields[i] & 0xFFFFFFFF);
+        writeWord(out, fields[i] >> 32);
+    }
+}
+
+static void
+writeStateString(OutputBuffer *out, const char *string, size_t length)
+{
+    writeWord(out, length);
+    writeBytes(out, string, length);
+}
+
+// Saves state, with the fingerprint of the executable just written, for the
+// next link of outFileStr.
+static int
+saveLinkState(LinkJob *job, LinkState *state, const char *outFileStr, const char *stateFileStr)
+{
+    OutputBuffer out;
+    int opened = -1;
+    if (takeFingerprint(outFileStr, &state->output) == 0 && (opened = openOutput(&out, stateFileStr)) == -2)
+        return failMemory(job);
+    if (opened != 0)
+        return fail(job, DIAGNOSTIC_IO, 1, -1, "error in opening %s\n", stateFileStr);
+    writeBytes(&out, LINKSTATEMAGIC, LINKSTATEMAGICSIZE);
+    writeWord(&out, LINKSTATEVERSION);
+    writeWord(&out, state->numInputs);
+    writeWord(&out, state->numFiles);
+    writeWord(&out, state->numUndefined);
+    writeWord(&out, state->numGlobals);
+    writeWord(&out, state->numSites);
+    writeWord(&out, state->textSize);
+    writeWord(&out, state->dataSize);
+    writeStateFingerprint(&out, &state->output);
+    for (unsigned int i = 0; i < state->numInputs; ++i)
+    {
+        writeStateString(&out, state->inputNames[i], strlen(state->inputNames[i]));
+        writeStateFingerprint(&out, &state->inputs[i]);
+    }
+    for (unsigned int i = 0; i < state->numFiles; ++i)
+    {
+        StateFile *file = &state->files[i];
+        writeWord(&out, file->input);
+        writeWord(&out, file->textSize);
+        writeWord(&out, file->dataSize);
+        writeWord(&out, file->textStartingLine);
+        writeWord(&out, file->dataStartingLine);
+        writeWord(&out, file->firstGlobal);
+        writeWord(&out, file->numGlobals);
+        writeWord(&out, file->numUndefined);
+    }
+    for (unsigned int i = 0; i < state->numUndefined; ++i)
+        writeStateString(&out, state->undefined[i], strlen(state->undefined[i]));
+    for (unsigned int i = 0; i < state->numGlobals; ++i)
+    {
+        writeStateString(&out, state->globals[i].label, state->globals[i].length);
+        writeWord(&out, state->globals[i].location);
+        writeWord(&out, state->globals[i].offset);
+    }
+    for (unsigned int i = 0; i < state->numSites; ++i)
+    {
+        writeWord(&out, state->sites[i].word);
+        writeWord(&out, state->sites[i].global);
+        writeWord(&out, state->sites[i].file);
+    }
+    if (closeOutput(&out) != 0)
+        return fail(job, DIAGNOSTIC_IO, 1, -1, "error in writing %s\n", stateFileStr);
+    return 0;
+}
+
+static uint32_t
+readStateWord(StateReader *reader)
+{
+    if (reader->end - reader->next < 4)
+    {
+        reader->failed = true;
+        return 0;
+    }
+    uint32_t word = loadWord(reader->next);
+    reader->next += 4;
+    return word;
+}
+
+static void
+readStateFingerprint(StateReader *reader, Fingerprint *fingerprint)
+{
+    uint64_t fields[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        uint64_t low = readStateWord(reader);
+        fields[i] = low | (uint64_t)readStateWord(reader) << 32;
+    }
+    fingerprint->size = fields[0];
+    fingerprint->inode = fields[1];
+    fingerprint->seconds = fields[2];
+    fingerprint->nanoseconds = fields[3];
+}
+
+static char *
+readStateString(StateReader *reader, Arena *arena)
+{
+    uint32_t length = readStateWord(reader);
+    if (reader->failed || (size_t)(reader->end - reader->next) < length)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    char *string = arenaString(arena, reader->next, length);
+    if (string == NULL)
+        reader->failed = true;
+    reader->next += length;
+    return string;
+}
+
+// Reads the state saved by saveLinkState into arena and checks that it
+// describes a consistent link. Returns 0 on success, -1 otherwise; running
+// out of memory fails the same way, so the link is done in full.
+static int
+loadLinkState(LinkState *state, const char *stateFileStr, Arena *arena)
+{
+    const char *buffer;
+    size_t size;
+    bool mapped;
+    if (loadFile(stateFileStr, &buffer, &size, &mapped) != 0)
+        return -1;
+    StateReader reader = {buffer, buffer + size, false};
+    if (size >= LINKSTATEMAGICSIZE && !memcmp(buffer, LINKSTATEMAGIC, LINKSTATEMAGICSIZE))
+        reader.next += LINKSTATEMAGICSIZE;
+    else
+        reader.failed = true;
+    if (reader.failed || readStateWord(&reader) != LINKSTATEVERSION)
+    {
+        unloadFile(buffer, size, mapped);
+        return -1;
+    }
+    state->numInputs = readStateWord(&reader);
+    state->numFiles = readStateWord(&reader);
+    state->numUndefined = readStateWord(&reader);
+    state->numGlobals = readStateWord(&reader);
+    state->numSites = readStateWord(&reader);
+    state->textSize = readStateWord(&reader);
+    state->dataSize = readStateWord(&reader);
+    readStateFingerprint(&reader, &state->output);
+
+    // every record takes at least four bytes, which bounds what is allocated
+    size_t left = reader.end - reader.next;
+    if (reader.failed || state->numInputs > left / 4 || state->numFiles > left / 4 ||
+        state->numUndefined > left / 4 || state->numGlobals > left / 4 || state->numSites > left / 4)
+    {
+        unloadFile(buffer, size, mapped);
+        return -1;
+    }
+
+    state->inputNames = arenaAlloc(arena, (state->numInputs + 1) * sizeof(char *));
+    state->inputs = arenaAlloc(arena, (state->numInputs + 1) * sizeof(Fingerprint));
+    if (state->inputNames == NULL || state->inputs == NULL)
+        reader.failed = true;
+    for (unsigned int i = 0; i < state->numInputs && !reader.failed; ++i)
+    {
+        state->inputNames[i] = readStateString(&reader, arena);
+        readStateFingerprint(&reader, &state->inputs[i]);
+    }
+
+    uint64_t size64 = (uint64_t)state->textSize + state->dataSize;
+    uint64_t numUndefined = 0;
+    state->files = arenaAlloc(arena, (state->numFiles + 1) * sizeof(StateFile));
+    if (state->files == NULL)
+        reader.failed = true;
+    for (unsigned int i = 0; i < state->numFiles && !reader.failed; ++i)
+    {
+        StateFile *file = &state->files[i];
+        file->input = readStateWord(&reader);
+        file->textSize = readStateWord(&reader);
+        file->dataSize = readStateWord(&reader);
+        file->textStartingLine = readStateWord(&reader);
+        file->dataStartingLine = readStateWord(&reader);
+        file->firstGlobal = readStateWord(&reader);
+        file->numGlobals = readStateWord(&reader);
+        file->numUndefined = readStateWord(&reader);
+        file->firstUndefined = numUndefined;
+        numUndefined += file->numUndefined;
+        if (file->input >= state->numInputs || numUndefined > state->numUndefined ||
+            (uint64_t)file->textStartingLine + file->textSize > state->textSize ||
+            (uint64_t)file->dataStartingLine + file->dataSize > state->dataSize ||
+            (uint64_t)file->firstGlobal + file->numGlobals > state->numGlobals)
+            reader.failed = true;
+    }
+    if (numUndefined != state->numUndefined)
+        reader.failed = true;
+
+    state->undefined = arenaAlloc(arena, (state->numUndefined + 1) * sizeof(char *));
+    if (state->undefined == NULL)
+        reader.failed = true;
+    for (unsigned int i = 0; i < state->numUndefined && !reader.failed; ++i)
+        state->undefined[i] = readStateString(&reader, arena);
+
+    state->globals = arenaAlloc(arena, (state->numGlobals + 1) * sizeof(SymbolTableEntry));
+    if (state->globals == NULL)
+        reader.failed = true;
+    for (unsigned int i = 0; i < state->numGlobals && !reader.failed; ++i)
+    {
+        const char *label = readStateString(&reader, arena);
+        state->globals[i].label = label;
+        state->globals[i].length = label != NULL ? strlen(label) : 0;
+        state->globals[i].location = readStateWord(&reader);
+        state->globals[i].offset = readStateWord(&reader);
+        if (state->globals[i].offset >= size64)
+            reader.failed = true;
+    }
+
+    state->sites = arenaAlloc(arena, (state->numSites + 1) * sizeof(RelocationSite));
+    if (state->sites == NULL)
+        reader.failed = true;
+    for (unsigned int i = 0; i < state->numSites && !reader.failed; ++i)
+    {
+        RelocationSite *site = &state->sites[i];
+        site->word = readStateWord(&reader);
+        site->global = readStateWord(&reader);
+        site->file = readStateWord(&reader);
+        if (site->word >= size64 || site->global >= state->numGlobals || site->file >= state->numFiles)
+            reader.failed = true;
+    }
+
+    bool failed = reader.failed || reader.next != reader.end;
+    unloadFile(buffer, size, mapped);
+    return failed ? -1 : 0;
+}
+
+// Reads file again for a streaming pass; the caller frees its object once
+// the pass is done with it. The layout was computed from the header, so the
+// file must not have changed size since.
+static int
+rereadFile(LinkJob *job, FileData *file)
+{
+    FileData fresh = *file;
+    int status = checkResult(job, readFileData(&fresh), file);
+    if (status != 0)
+        return status;
+    if (fresh.textSize != file->textSize || fresh.dataSize != file->dataSize ||
+        fresh.symbolTableSize != file->symbolTableSize ||
+        fresh.relocationTableSize != file->relocationTableSize)
+    {
+        freeObject(&fresh.object);
+        return fail(job, DIAGNOSTIC_CHANGED_INPUT, 1, file->input, "error: %s changed while linking\n", file->name);
+    }
+    *file = fresh;
+    return 0;
+}
+
+// Reads the object file named by file, or its bytes in memory, into
+// file->object and points file's tables at the object's. Nothing is copied:
+// the words are relocated where readObject put them and labels stay in the
+// file's bytes. Returns readObject's result.
+static int
+readFileData(FileData *file)
+{
+    int result = file->bytes != NULL ? readObjectBuffer(file->bytes, file->size, &file->object)
+                                     : readObject(file->name, &file->object);
+    if (result != 0)
+        return result;
+
+    ObjectFile *object = &file->object;
+    file->textSize = object->textSize;
+    file->dataSize = object->dataSize;
+    file->symbolTableSize = object->symbolTableSize;
+    file->relocationTableSize = object->relocationTableSize;
+    file->text = object->text;
+    file->data = object->data;
+    file->symbolTable = object->symbols;
+    file->relocTable = object->relocations;
+    return 0;
+}
+
+// Reads only the table sizes of file. Returns readObject's result.
+static int
+readFileHeader(FileData *file)
+{
+    ObjectFile header;
+    int result;
+    if (file->bytes == NULL)
+        result = readObjectHeader(file->name, &header);
+    else if ((result = readObjectBuffer(file->bytes, file->size, &header)) == 0)
+        freeObject(&header);
+    if (result != 0)
+        return result;
+    file->textSize = header.textSize;
+    file->dataSize = header.dataSize;
+    file->symbolTableSize = header.symbolTableSize;
+    file->relocationTableSize = header.relocationTableSize;
+    return 0;
+}
+
+static void *
+readWorker(void *arg)
+{
+    ReadWorker *worker = arg;
+    ReadQueue *queue = worker->queue;
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->lock);
+        unsigned int next = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (next >= queue->numFiles)
+            return NULL;
+        queue->results[next] = readFileData(&queue->files[next]);
+    }
+}
+
+// Reads every file on a pool of one reader per online CPU, the calling
+// thread included, and waits for all of them.
+static void
+readFiles(FileData *files, unsigned int numFiles, int *results, Arena *arena)
+{
+    ReadQueue queue = {files, numFiles, results, 0};
+    pthread_mutex_init(&queue.lock, NULL);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int count = cpus < 1 ? 1 : cpus;
+    if (count > numFiles)
+        count = numFiles;
+    // without memory for a pool, the calling thread reads every file itself
+    ReadWorker self;
+    ReadWorker *workers = arenaAlloc(arena, count * sizeof(ReadWorker));
+    if (workers == NULL)
+    {
+        workers = &self;
+        count = 1;
+    }
+    for (unsigned int i = 0; i < count; ++i)
+        workers[i].queue = &queue;
+
+    // if a thread cannot be created, the readers already running take its share
+    unsigned int started = 1;
+    while (started < count && pthread_create(&workers[started].thread, NULL, readWorker, &workers[started]) == 0)
+        ++started;
+    readWorker(&workers[0]);
+    for (unsigned int i = 1; i < started; ++i)
+        pthread_join(workers[i].thread, NULL);
+    pthread_mutex_destroy(&queue.lock);
+}
+
+// Tells whether the length bytes at label spell string.
+static inline bool
+isLabel(const char *label, int length, const char *string)
+{
+    return !strncmp(label, string, length) && string[length] == '\0';
+}
+
+// Returns 0, or -1 if memory ran out.
+static int
+initGlobalTable(GlobalTable *table, Arena *arena, SymbolTableEntry *symbols, unsigned int maxSymbols)
+{
+    table->symbols = symbols;
+    table->numSlots = 16;
+    while (table->numSlots < 2 * maxSymbols)
+        table->numSlots *= 2;
+    table->slots = arenaAlloc(arena, table->numSlots * sizeof(int));
+    if (table->slots == NULL)
+        return -1;
+    memset(table->slots, 0, table->numSlots * sizeof(int));
+    return 0;
+}
+
+// Returns the merged symbol named label, or NULL if no file defines it.
+static SymbolTableEntry *
+findGlobal(GlobalTable *table, const char *label, int length)
+{
+    unsigned int slot = hashLabel(label, length) & (table->numSlots - 1);
+    while (table->slots[slot])
+    {
+        SymbolTableEntry *symbol = &table->symbols[table->slots[slot] - 1];
+        if (symbol->length == length && !memcmp(symbol->label, label, length))
+            return symbol;
+        slot = (slot + 1) & (table->numSlots - 1);
+    }
+    return NULL;
+}
+
+// Indexes symbols[index]. The caller has checked its label is not present.
+static void
+addGlobal(GlobalTable *table, unsigned int index)
+{
+    SymbolTableEntry *symbol = &table->symbols[index];
+    unsigned int slot = hashLabel(symbol->label, symbol->length) & (table->numSlots - 1);
+    while (table->slots[slot])
+        slot = (slot + 1) & (table->numSlots - 1);
+    table->slots[slot] = index + 1;
+}
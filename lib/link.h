@@ -0,0 +1,58 @@
+/**
+ * Project 2
+ * LC-2K linker, as a library the linker command and server share
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "diagnostic.h"
+#include "outbuf.h"
+
+typedef struct LinkInput LinkInput;
+typedef struct LinkJob LinkJob;
+
+// An object file or archive to link. If bytes is NULL the file at name is
+// read; otherwise the size bytes at bytes are, and name only stands for them
+// in messages. Archives are told from object files by their magic.
+struct LinkInput
+{
+    const char *name;
+    const char *bytes;
+    size_t size;
+};
+
+// One link of inputs, in order, MAIN's object first. streaming holds only one
+// object in memory at a time. incremental patches the executable of the
+// previous link of the same file; it applies to linkFile when every input is
+// a file. log, unless NULL, receives the progress lines the linker command
+// prints. report, unless NULL, receives a JSON description of a successful
+// link: where every module and global landed, how many relocations of each
+// kind were made and how long each phase took. A reported link is always a
+// full one. diagnostic says why the link failed.
+struct LinkJob
+{
+    LinkInput *inputs;
+    int numInputs;
+    bool streaming;
+    bool incremental;
+    FILE *log;
+    FILE *report;
+    Diagnostic diagnostic;
+};
+
+// Links job's inputs into an executable written to out, which may be a file
+// or memory output. Returns 0 on success, otherwise the linker's exit status,
+// with job->diagnostic saying why. Jobs share no state, so any number may run
+// at once.
+int linkObjects(LinkJob *job, OutputBuffer *out);
+
+// Links job's inputs into the executable at path. A failed full link leaves
+// it empty. Returns like linkObjects.
+int linkFile(LinkJob *job, const char *path);
+
+#endif
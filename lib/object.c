@@ -0,0 +1,746 @@
+/**
+ * Project 2
+ * LC-2K object files, shared by the assembler, linker and objconv
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "object.h"
+
+const char *const relocationOpcodeNames[3] = {".fill", "lw", "sw"};
+
+char *readStream(FILE *inFilePtr, size_t *size)
+{
+    size_t capacity = 1 << 16;
+    size_t length = 0;
+    char *buffer = malloc(capacity + 1);
+    while (buffer != NULL)
+    {
+        length += fread(buffer + length, 1, capacity - length, inFilePtr);
+        if (length < capacity)
+            break;
+        capacity *= 2;
+        char *grown = realloc(buffer, capacity + 1);
+        if (grown == NULL)
+            free(buffer);
+        buffer = grown;
+    }
+    if (buffer == NULL)
+        return NULL;
+    buffer[length] = '\0';
+    *size = length;
+    return buffer;
+}
+
+int loadFile(const char *path, const char **buffer, size_t *size, bool *mapped)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            close(fd);
+            posix_madvise(data, info.st_size, POSIX_MADV_SEQUENTIAL);
+            *buffer = data;
+            *size = info.st_size;
+            *mapped = true;
+            return 0;
+        }
+    }
+
+    FILE *inFilePtr = fdopen(fd, "rb");
+    if (inFilePtr == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+    *buffer = readStream(inFilePtr, size);
+    fclose(inFilePtr);
+    *mapped = false;
+    return *buffer == NULL ? -1 : 0;
+}
+
+void unloadFile(const char *buffer, size_t size, bool mapped)
+{
+    if (mapped)
+        munmap((void *)buffer, size);
+    else
+        free((void *)buffer);
+}
+
+// Allocates the word, symbol and relocation tables of object in one block.
+static int
+allocateTables(ObjectFile *object)
+{
+    size_t symbolBytes = object->symbolTableSize * sizeof(ObjectSymbol);
+    size_t relocationBytes = object->relocationTableSize * sizeof(ObjectRelocation);
+    size_t wordBytes = ((size_t)object->textSize + object->dataSize) * sizeof(int);
+    char *tables = malloc(symbolBytes + relocationBytes + wordBytes + 1);
+    if (tables == NULL)
+        return -1;
+    object->tables = tables;
+    object->symbols = (ObjectSymbol *)tables;
+    object->relocations = (ObjectRelocation *)(tables + symbolBytes);
+    object->text = (int *)(tables + symbolBytes + relocationBytes);
+    object->data = object->text + object->textSize;
+    return 0;
+}
+
+/*
+ * Scanner for the text format. It works on [cursor, end) slices of the
+ * buffer and never writes to it, since the buffer may be a read-only
+ * mapping. Fields are parsed exactly as the sscanf and strtol calls of the
+ * old reader did.
+ */
+
+// The characters isspace accepts in the C locale
+static const bool spaceChars[256] = {
+    [' '] = true, ['\t'] = true, ['\n'] = true, ['\v'] = true, ['\f'] = true, ['\r'] = true,
+};
+
+static inline bool
+isSpace(char c)
+{
+    return spaceChars[(unsigned char)c];
+}
+
+static inline const char *
+skipSpace(const char *ptr, const char *end)
+{
+    while (ptr < end && isSpace(*ptr))
+        ++ptr;
+    return ptr;
+}
+
+// Returns the value of c as a digit in base, or -1 if it is not one.
+static inline int
+digitValue(char c, int base)
+{
+    unsigned int value;
+    if ((unsigned char)(c - '0') < 10)
+        value = c - '0';
+    else if ((unsigned char)((c | 0x20) - 'a') < 6)
+        value = (c | 0x20) - 'a' + 10;
+    else
+        return -1;
+    return value < (unsigned int)base ? (int)value : -1;
+}
+
+// Parses an integer at *cursor like strtol with base 0 (C prefixes) or 10,
+// truncating the saturated long to an int as "%d" and the old casts did.
+// Returns 0 and advances *cursor past it, or -1 if there is no number.
+static int
+scanInteger(const char **cursor, const char *end, int base, int *value)
+{
+    const char *ptr = skipSpace(*cursor, end);
+    bool negative = false;
+    if (ptr < end && (*ptr == '-' || *ptr == '+'))
+        negative = *ptr++ == '-';
+
+    if (base == 0)
+    {
+        if (end - ptr > 2 && ptr[0] == '0' && (ptr[1] | 0x20) == 'x' && digitValue(ptr[2], 16) >= 0)
+        {
+            base = 16;
+            ptr += 2;
+        }
+        else if (ptr < end && *ptr == '0')
+            base = 8;
+        else
+            base = 10;
+    }
+
+    const char *digits = ptr;
+    unsigned long magnitude = 0;
+    bool overflow = false;
+    int digit;
+    for (; ptr < end && (digit = digitValue(*ptr, base)) >= 0; ++ptr)
+    {
+        if (magnitude > (ULONG_MAX - digit) / base)
+            overflow = true;
+        else
+            magnitude = magnitude * base + digit;
+    }
+    if (ptr == digits)
+        return -1;
+
+    long number;
+    if (negative)
+        number = (overflow || magnitude > (unsigned long)LONG_MAX + 1) ? LONG_MIN : (long)(0UL - magnitude);
+    else
+        number = (overflow || magnitude > LONG_MAX) ? LONG_MAX : (long)magnitude;
+    *value = (int)number;
+    *cursor = ptr;
+    return 0;
+}
+
+// Sets *start and *length to the next whitespace-delimited field, as "%s"
+// would read it. Returns -1 if the rest of the line is blank.
+static int
+scanField(const char **cursor, const char *end, const char **start, int *length)
+{
+    const char *ptr = skipSpace(*cursor, end);
+    const char *field = ptr;
+    while (ptr < end && !isSpace(*ptr))
+        ++ptr;
+    if (ptr == field)
+        return -1;
+    *start = field;
+    *length = ptr - field;
+    *cursor = ptr;
+    return 0;
+}
+
+// Sets *line and *lineEnd to the next line of the buffer, without its
+// newline. Returns -1 at the end of the buffer.
+static inline int
+nextLine(const char **cursor, const char *end, const char **line, const char **lineEnd)
+{
+    if (*cursor >= end)
+        return -1;
+    const char *newline = memchr(*cursor, '\n', end - *cursor);
+    if (newline == NULL)
+        newline = end;
+    *line = *cursor;
+    *lineEnd = newline;
+    *cursor = newline + 1;
+    return 0;
+}
+
+// 0x10 | value of every hex digit, 0 for any other character
+static const unsigned char hexDigits[256] = {
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+    ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+    ['A'] = 0x1A, ['B'] = 0x1B, ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E, ['F'] = 0x1F,
+    ['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D, ['e'] = 0x1E, ['f'] = 0x1F,
+};
+
+// Decodes a "0x%08X" line, the only form the assembler writes, straight from
+// the buffer without branching per digit. Returns -1 if the line has any
+// other form.
+static inline int
+scanHexWord(const char *ptr, const char *end, int *value)
+{
+    if (end - ptr < 11 || ptr[0] != '0' || ptr[1] != 'x' || ptr[10] != '\n')
+        return -1;
+    unsigned int valid = 0x10;
+    uint32_t word = 0;
+    for (int i = 2; i < 10; ++i)
+    {
+        unsigned int digit = hexDigits[(unsigned char)ptr[i]];
+        valid &= digit;
+        word = word << 4 | (digit & 0xF);
+    }
+    if (!valid)
+        return -1;
+    *value = (int)word;
+    return 0;
+}
+
+static inline bool
+isGlobalLabel(const char *label, int length)
+{
+    return length && label[0] >= 'A' && label[0] <= 'Z';
+}
+
+// Points every relocation of a global label at the first symbol with that
+// label, for formats that name only the label. Returns -2 if a global has no
+// symbol, which the assembler never writes, and -3 if memory ran out.
+static int
+indexRelocations(ObjectFile *object)
+{
+    int numSlots = 16;
+    while (numSlots < 2 * object->symbolTableSize)
+        numSlots *= 2;
+    int *slots = calloc(numSlots, sizeof(int));
+    if (slots == NULL)
+        return -3;
+
+    // slots hold 1 + index into symbols; an earlier duplicate is found first
+    for (int i = 0; i < object->symbolTableSize; ++i)
+    {
+        unsigned int slot = hashLabel(object->symbols[i].label, object->symbols[i].length) & (numSlots - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (numSlots - 1);
+        slots[slot] = i + 1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < object->relocationTableSize && result == 0; ++i)
+    {
+        ObjectRelocation *relocation = &object->relocations[i];
+        relocation->symbol = OBJECTLOCAL;
+        if (!isGlobalLabel(relocation->label, relocation->length))
+            continue;
+        unsigned int slot = hashLabel(relocation->label, relocation->length) & (numSlots - 1);
+        while (slots[slot])
+        {
+            ObjectSymbol *symbol = &object->symbols[slots[slot] - 1];
+            if (symbol->length == relocation->length && !memcmp(symbol->label, relocation->label, symbol->length))
+            {
+                relocation->symbol = slots[slot] - 1;
+                break;
+            }
+            slot = (slot + 1) & (numSlots - 1);
+        }
+        if (relocation->symbol == OBJECTLOCAL)
+            result = -2;
+    }
+    free(slots);
+    return result;
+}
+
+// Parses the header line "textSize dataSize symbolTableSize
+// relocationTableSize" and leaves cursor at the first word.
+static int
+parseTextHeader(ObjectFile *object, const char **cursor)
+{
+    const char *end = object->buffer + object->bufferSize;
+    const char *line, *lineEnd;
+
+    // parse first line of file
+    if (nextLine(cursor, end, &line, &lineEnd) != 0 ||
+        scanInteger(&line, lineEnd, 10, &object->textSize) != 0 ||
+        scanInteger(&line, lineEnd, 10, &object->dataSize) != 0 ||
+        scanInteger(&line, lineEnd, 10, &object->symbolTableSize) != 0 ||
+        scanInteger(&line, lineEnd, 10, &object->relocationTableSize) != 0)
+        return -2;
+    if (object->textSize < 0 || object->dataSize < 0 ||
+        object->symbolTableSize < 0 || object->relocationTableSize < 0)
+        return -2;
+    // every entry takes at least one line
+    if ((size_t)object->textSize + object->dataSize + object->symbolTableSize +
+            object->relocationTableSize > object->bufferSize)
+        return -2;
+    return 0;
+}
+
+static int
+parseTextObject(ObjectFile *object)
+{
+    const char *cursor = object->buffer;
+    const char *end = object->buffer + object->bufferSize;
+    const char *line, *lineEnd;
+
+    if (parseTextHeader(object, &cursor) != 0)
+        return -2;
+    if (allocateTables(object) != 0)
+        return -3;
+
+    // read in text and data sections
+    for (int i = 0; i < object->textSize + object->dataSize; ++i)
+    {
+        if (scanHexWord(cursor, end, &object->text[i]) == 0)
+        {
+            cursor += 11;
+            continue;
+        }
+        if (nextLine(&cursor, end, &line, &lineEnd) != 0)
+            return -2;
+        // a line that is not a number reads as 0, as strtol returned
+        if (scanInteger(&line, lineEnd, 0, &object->text[i]) != 0)
+            object->text[i] = 0;
+    }
+
+    // read in the symbol table: label, T/D/U and offset
+    for (int i = 0; i < object->symbolTableSize; ++i)
+    {
+        ObjectSymbol *symbol = &object->symbols[i];
+        if (nextLine(&cursor, end, &line, &lineEnd) != 0 ||
+            scanField(&line, lineEnd, &symbol->label, &symbol->length) != 0)
+            return -2;
+        line = skipSpace(line, lineEnd);
+        if (line == lineEnd)
+            return -2;
+        symbol->area = *line++;
+        if (scanInteger(&line, lineEnd, 10, &symbol->offset) != 0)
+            return -2;
+    }
+
+    // read in relocation table: offset, opcode and label
+    for (int i = 0; i < object->relocationTableSize; ++i)
+    {
+        ObjectRelocation *relocation = &object->relocations[i];
+        const char *opcodeName;
+        int opcodeLength;
+        if (nextLine(&cursor, end, &line, &lineEnd) != 0 ||
+            scanInteger(&line, lineEnd, 10, &relocation->offset) != 0 ||
+            scanField(&line, lineEnd, &opcodeName, &opcodeLength) != 0 ||
+            scanField(&line, lineEnd, &relocation->label, &relocation->length) != 0)
+            return -2;
+        int opcode = 0;
+        while (opcode < 3 && (strlen(relocationOpcodeNames[opcode]) != (size_t)opcodeLength ||
+                              memcmp(opcodeName, relocationOpcodeNames[opcode], opcodeLength)))
+            ++opcode;
+        if (opcode == 3)
+            return -2;
+        relocation->opcode = opcode;
+        relocation->section = opcode == RELOC_FILL ? SECTION_DATA : SECTION_TEXT;
+    }
+    return indexRelocations(object);
+}
+
+// Checks the binary header against the file size and sets the table sizes,
+// stringTableSize and the format version from it.
+static int
+parseBinaryHeader(ObjectFile *object, size_t *stringTableSize, uint32_t *version)
+{
+    const char *buffer = object->buffer;
+    size_t size = object->bufferSize;
+    if (size < OBJECTHEADERSIZE)
+        return -2;
+    *version = loadWord(buffer + 8);
+    if (*version != 1 && *version != OBJECTVERSION)
+        return -2;
+    uint32_t counts[5];
+    for (int i = 0; i < 5; ++i)
+    {
+        counts[i] = loadWord(buffer + 12 + 4 * i);
+        if (counts[i] > INT32_MAX)
+            return -2;
+    }
+    size_t words = (size_t)counts[0] + counts[1];
+    size_t relocationSize = *version == 1 ? OBJECTRELOCATIONSIZEV1 : OBJECTRELOCATIONSIZE;
+    if (OBJECTHEADERSIZE + 4 * words + OBJECTSYMBOLSIZE * (size_t)counts[2] + relocationSize * counts[3] +
+            counts[4] !=
+        size)
+        return -2;
+
+    object->textSize = counts[0];
+    object->dataSize = counts[1];
+    object->symbolTableSize = counts[2];
+    object->relocationTableSize = counts[3];
+    *stringTableSize = counts[4];
+    return 0;
+}
+
+static int
+parseBinaryObject(ObjectFile *object)
+{
+    const char *buffer = object->buffer;
+    size_t size = object->bufferSize;
+    size_t stringTableSize;
+    uint32_t version;
+    if (parseBinaryHeader(object, &stringTableSize, &version) != 0)
+        return -2;
+    size_t records = (size_t)object->symbolTableSize + object->relocationTableSize;
+
+    // every label must end inside the string table
+    const char *strings = buffer + size - stringTableSize;
+    if (records && (stringTableSize == 0 || strings[stringTableSize - 1] != '\0'))
+        return -2;
+
+    if (allocateTables(object) != 0)
+        return -3;
+
+    const char *ptr = buffer + OBJECTHEADERSIZE;
+    for (size_t i = 0; i < (size_t)object->textSize + object->dataSize; ++i, ptr += 4)
+        object->text[i] = (int)loadWord(ptr);
+
+    for (int i = 0; i < object->symbolTableSize; ++i, ptr += OBJECTSYMBOLSIZE)
+    {
+        ObjectSymbol *symbol = &object->symbols[i];
+        uint32_t label = loadWord(ptr);
+        symbol->offset = (int)loadWord(ptr + 4);
+        symbol->area = ptr[8];
+        if (label >= stringTableSize ||
+            (symbol->area != 'T' && symbol->area != 'D' && symbol->area != 'U'))
+            return -2;
+        symbol->label = strings + label;
+        symbol->length = strlen(symbol->label);
+    }
+
+    if (version == 1)
+    {
+        for (int i = 0; i < object->relocationTableSize; ++i, ptr += OBJECTRELOCATIONSIZEV1)
+        {
+            ObjectRelocation *relocation = &object->relocations[i];
+            relocation->offset = (int)loadWord(ptr);
+            uint32_t label = loadWord(ptr + 4);
+            unsigned char opcode = ptr[8];
+            if (label >= stringTableSize || opcode > RELOC_SW)
+                return -2;
+            relocation->opcode = opcode;
+            relocation->section = opcode == RELOC_FILL ? SECTION_DATA : SECTION_TEXT;
+            relocation->label = strings + label;
+            relocation->length = strlen(relocation->label);
+        }
+        return indexRelocations(object);
+    }
+
+    // the section must agree with the opcode and a global with its symbol
+    for (int i = 0; i < object->relocationTableSize; ++i, ptr += OBJECTRELOCATIONSIZE)
+    {
+        ObjectRelocation *relocation = &object->relocations[i];
+        relocation->offset = (int)loadWord(ptr);
+        uint32_t label = loadWord(ptr + 4);
+        uint32_t symbol = loadWord(ptr + 8);
+        unsigned char opcode = ptr[12];
+        unsigned char section = ptr[13];
+        if (label >= stringTableSize || opcode > RELOC_SW ||
+            section != (opcode == RELOC_FILL ? SECTION_DATA : SECTION_TEXT))
+            return -2;
+        relocation->opcode = opcode;
+        relocation->section = section;
+        relocation->label = strings + label;
+        relocation->length = strlen(relocation->label);
+        if (symbol != OBJECTLOCAL &&
+            (symbol >= (uint32_t)object->symbolTableSize || object->symbols[symbol].label != relocation->label))
+            return -2;
+        if (symbol == OBJECTLOCAL && isGlobalLabel(relocation->label, relocation->length))
+            return -2;
+        relocation->symbol = symbol;
+    }
+    return 0;
+}
+
+// Parses object->buffer in whichever format its first bytes announce.
+static int
+parseObject(ObjectFile *object)
+{
+    if (object->bufferSize >= OBJECTMAGICSIZE && !memcmp(object->buffer, OBJECTMAGIC, OBJECTMAGICSIZE))
+    {
+        object->format = OBJECT_BINARY;
+        return parseBinaryObject(object);
+    }
+    object->format = OBJECT_TEXT;
+    return parseTextObject(object);
+}
+
+int readObject(const char *path, ObjectFile *object)
+{
+    memset(object, 0, sizeof(*object));
+    if (loadFile(path, &object->buffer, &object->bufferSize, &object->mapped) != 0)
+        return -1;
+
+    int result = parseObject(object);
+    if (result != 0)
+        freeObject(object);
+    return result;
+}
+
+int readObjectBuffer(const char *buffer, size_t size, ObjectFile *object)
+{
+    memset(object, 0, sizeof(*object));
+    object->buffer = buffer;
+    object->bufferSize = size;
+    int result = parseObject(object);
+
+    // the bytes stay the caller's
+    object->buffer = NULL;
+    object->bufferSize = 0;
+    if (result != 0)
+        freeObject(object);
+    return result;
+}
+
+int readObjectHeader(const char *path, ObjectFile *object)
+{
+    memset(object, 0, sizeof(*object));
+    if (loadFile(path, &object->buffer, &object->bufferSize, &object->mapped) != 0)
+        return -1;
+
+    // only the pages holding the header are touched
+    int result;
+    size_t stringTableSize;
+    uint32_t version;
+    const char *cursor = object->buffer;
+    if (object->bufferSize >= OBJECTMAGICSIZE && !memcmp(object->buffer, OBJECTMAGIC, OBJECTMAGICSIZE))
+    {
+        object->format = OBJECT_BINARY;
+        result = parseBinaryHeader(object, &stringTableSize, &version);
+    }
+    else
+    {
+        object->format = OBJECT_TEXT;
+        result = parseTextHeader(object, &cursor);
+    }
+    freeObject(object);
+    return result;
+}
+
+void freeObject(ObjectFile *object)
+{
+    if (object->buffer != NULL)
+        unloadFile(object->buffer, object->bufferSize, object->mapped);
+    free(object->tables);
+    object->buffer = NULL;
+    object->tables = NULL;
+}
+
+static void
+writeTextObject(OutputBuffer *out, ObjectFile *object)
+{
+    int header[4] = {object->textSize, object->dataSize,
+                     object->symbolTableSize, object->relocationTableSize};
+    for (int i = 0; i < 4; ++i)
+    {
+        writeDecimal(out, header[i]);
+        writeChar(out, i < 3 ? ' ' : '\n');
+    }
+    for (int i = 0; i < object->textSize; ++i)
+        writeHex(out, object->text[i]);
+    for (int i = 0; i < object->dataSize; ++i)
+        writeHex(out, object->data[i]);
+
+    for (int i = 0; i < object->symbolTableSize; ++i)
+    {
+        ObjectSymbol *symbol = &object->symbols[i];
+        writeBytes(out, symbol->label, symbol->length);
+        writeChar(out, ' ');
+        writeChar(out, symbol->area);
+        writeChar(out, ' ');
+        writeDecimal(out, symbol->offset);
+        writeChar(out, '\n');
+    }
+    for (int i = 0; i < object->relocationTableSize; ++i)
+    {
+        ObjectRelocation *relocation = &object->relocations[i];
+        writeDecimal(out, relocation->offset);
+        writeChar(out, ' ');
+        writeBytes(out, relocationOpcodeNames[relocation->opcode],
+                   strlen(relocationOpcodeNames[relocation->opcode]));
+        writeChar(out, ' ');
+        writeBytes(out, relocation->label, relocation->length);
+        writeChar(out, '\n');
+    }
+}
+
+// String table under construction. slots hold 1 + index into offsets.
+typedef struct StringTable
+{
+    char *strings;
+    size_t size;
+    size_t capacity;
+    uint32_t *offsets;
+    int count;
+    int *slots;
+    int numSlots;
+} StringTable;
+
+// Sets offset to that of label in the table, adding it on first use.
+// Returns 0, or -1 if memory ran out.
+static int
+internString(StringTable *table, const char *label, int length, uint32_t *offset)
+{
+    unsigned int slot = hashLabel(label, length) & (table->numSlots - 1);
+    while (table->slots[slot])
+    {
+        const char *string = table->strings + table->offsets[table->slots[slot] - 1];
+        if (!strncmp(string, label, length) && string[length] == '\0')
+        {
+            *offset = table->offsets[table->slots[slot] - 1];
+            return 0;
+        }
+        slot = (slot + 1) & (table->numSlots - 1);
+    }
+
+    while (table->size + length + 1 > table->capacity)
+    {
+        char *grown = realloc(table->strings, 2 * table->capacity);
+        if (grown == NULL)
+            return -1;
+        table->strings = grown;
+        table->capacity *= 2;
+    }
+    *offset = table->size;
+    memcpy(table->strings + *offset, label, length);
+    table->strings[*offset + length] = '\0';
+    table->size += length + 1;
+    table->offsets[table->count] = *offset;
+    table->slots[slot] = ++table->count;
+    return 0;
+}
+
+// Writes nothing if memory runs out while the string table is built.
+static int
+writeBinaryObject(OutputBuffer *out, ObjectFile *object)
+{
+    int records = object->symbolTableSize + object->relocationTableSize;
+    StringTable table;
+    table.size = 0;
+    table.capacity = 1024;
+    table.count = 0;
+    table.numSlots = 16;
+    while (table.numSlots < 2 * records)
+        table.numSlots *= 2;
+    table.strings = malloc(table.capacity);
+    table.offsets = malloc((records + 1) * sizeof(uint32_t));
+    table.slots = calloc(table.numSlots, sizeof(int));
+    uint32_t *labels = malloc((records + 1) * sizeof(uint32_t));
+    int status = table.strings == NULL || table.offsets == NULL || table.slots == NULL || labels == NULL ? -1 : 0;
+
+    for (int i = 0; i < object->symbolTableSize && status == 0; ++i)
+        status = internString(&table, object->symbols[i].label, object->symbols[i].length, &labels[i]);
+    for (int i = 0; i < object->relocationTableSize && status == 0; ++i)
+        status = internString(&table, object->relocations[i].label, object->relocations[i].length,
+                              &labels[object->symbolTableSize + i]);
+    if (status != 0)
+    {
+        free(labels);
+        free(table.slots);
+        free(table.offsets);
+        free(table.strings);
+        return -1;
+    }
+
+    writeBytes(out, OBJECTMAGIC, OBJECTMAGICSIZE);
+    writeWord(out, OBJECTVERSION);
+    writeWord(out, object->textSize);
+    writeWord(out, object->dataSize);
+    writeWord(out, object->symbolTableSize);
+    writeWord(out, object->relocationTableSize);
+    writeWord(out, table.size);
+
+    for (int i = 0; i < object->textSize; ++i)
+        writeWord(out, object->text[i]);
+    for (int i = 0; i < object->dataSize; ++i)
+        writeWord(out, object->data[i]);
+
+    char pad[4] = {0};
+    for (int i = 0; i < object->symbolTableSize; ++i)
+    {
+        writeWord(out, labels[i]);
+        writeWord(out, object->symbols[i].offset);
+        pad[0] = object->symbols[i].area;
+        writeBytes(out, pad, 4);
+    }
+    for (int i = 0; i < object->relocationTableSize; ++i)
+    {
+        writeWord(out, object->relocations[i].offset);
+        writeWord(out, labels[object->symbolTableSize + i]);
+        writeWord(out, object->relocations[i].symbol);
+        pad[0] = object->relocations[i].opcode;
+        pad[1] = object->relocations[i].section;
+        writeBytes(out, pad, 4);
+    }
+    writeBytes(out, table.strings, table.size);
+
+    free(labels);
+    free(table.slots);
+    free(table.offsets);
+    free(table.strings);
+    return 0;
+}
+
+int writeObject(OutputBuffer *out, ObjectFile *object, enum ObjectFormat format)
+{
+    if (format == OBJECT_BINARY)
+        return writeBinaryObject(out, object);
+    writeTextObject(out, object);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * Project 2
+ * LC-2K object files, shared by the assembler, linker and objconv
+ */
+
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "outbuf.h"
+
+/*
+ * Object files come in two formats.
+ *
+ * The text format is the one from the project spec: a header line
+ * "textSize dataSize symbolTableSize relocationTableSize", one hex word per
+ * line, "label T/D/U offset" symbol lines and "offset opcode label"
+ * relocation lines.
+ *
+ * The binary format holds the same information in fixed-width little-endian
+ * fields:
+ *     char     magic[8]            "LC2KOBJ\0"
+ *     uint32   version             OBJECTVERSION
+ *     uint32   textSize, dataSize, symbolTableSize, relocationTableSize
+ *     uint32   stringTableSize
+ *     int32    words[textSize + dataSize]
+ *     symbols  { uint32 label; uint32 offset; uint8 area; uint8 pad[3]; }
+ *     relocs   { uint32 offset; uint32 label; uint32 symbol;
+ *                uint8 opcode; uint8 section; uint8 pad[2]; }
+ *     char     strings[stringTableSize]
+ * Labels are offsets of NUL-terminated strings in the string table, and
+ * each distinct label is stored once. opcode is an enum RelocationOpcode and
+ * section an enum ObjectSection. symbol is the index in the symbol table of
+ * the global a relocation refers to, or OBJECTLOCAL for a local label.
+ * Version 1 relocations lack symbol and section and take 12 bytes; they
+ * are still read.
+ */
+#define OBJECTMAGIC "LC2KOBJ"
+#define OBJECTMAGICSIZE 8
+#define OBJECTVERSION 2
+#define OBJECTHEADERSIZE 32
+#define OBJECTSYMBOLSIZE 12
+#define OBJECTRELOCATIONSIZE 16
+#define OBJECTRELOCATIONSIZEV1 12
+#define OBJECTLOCAL 0xFFFFFFFFu
+
+typedef struct ObjectSymbol ObjectSymbol;
+typedef struct ObjectRelocation ObjectRelocation;
+typedef struct ObjectFile ObjectFile;
+
+enum ObjectFormat
+{
+    OBJECT_TEXT,
+    OBJECT_BINARY
+};
+
+// The instruction a relocation patches, which also tells its section.
+enum RelocationOpcode
+{
+    RELOC_FILL, // .fill, in the data section
+    RELOC_LW,
+    RELOC_SW
+};
+
+enum ObjectSection
+{
+    SECTION_TEXT,
+    SECTION_DATA
+};
+
+// Labels are not NUL-terminated in general; use length.
+struct ObjectSymbol
+{
+    const char *label;
+    int length;
+    char area; // T/D/U
+    int offset;
+};
+
+// symbol indexes the object's symbols, or is OBJECTLOCAL if label is local
+// to the file. Readers fill it in for every format; a label that starts with
+// a capital letter is global and must have a symbol.
+struct ObjectRelocation
+{
+    int offset;
+    enum RelocationOpcode opcode;
+    enum ObjectSection section;
+    unsigned int symbol;
+    const char *label;
+    int length;
+};
+
+// An object file in memory. text and data are consecutive in words.
+// readObject owns buffer and tables and releases them in freeObject; a
+// caller that fills an ObjectFile itself leaves both NULL. buffer holds the
+// file's bytes, usually as a read-only mapping, and labels point into it;
+// it is NULL if the bytes belong to the caller of readObjectBuffer.
+struct ObjectFile
+{
+    int textSize;
+    int dataSize;
+    int symbolTableSize;
+    int relocationTableSize;
+    int *text;
+    int *data;
+    ObjectSymbol *symbols;
+    ObjectRelocation *relocations;
+    enum ObjectFormat format;
+    const char *buffer;
+    size_t bufferSize;
+    bool mapped;
+    void *tables;
+};
+
+extern const char *const relocationOpcodeNames[3];
+
+// Reads the object file at path in either format. Returns 0 on success, -1
+// if the file cannot be opened, -2 if it is not a well-formed object and -3
+// if memory ran out.
+int readObject(const char *path, ObjectFile *object);
+
+// Parses an object file held in memory, such as an archive member. Labels
+// point into buffer, which must outlive object. Returns like readObject.
+int readObjectBuffer(const char *buffer, size_t size, ObjectFile *object);
+
+// Reads only the table sizes of the object file at path. Nothing needs to be
+// freed afterwards. Returns like readObject.
+int readObjectHeader(const char *path, ObjectFile *object);
+
+void freeObject(ObjectFile *object);
+
+// Gets the bytes of the file at path: a read-only mapping for regular files,
+// a heap buffer for anything else. Returns 0 on success, -1 if the file
+// cannot be opened or read. unloadFile releases them.
+int loadFile(const char *path, const char **buffer, size_t *size, bool *mapped);
+void unloadFile(const char *buffer, size_t size, bool mapped);
+
+// Reads the whole stream into a NUL-terminated heap buffer, for pipes and
+// anything else that cannot be mapped. Returns NULL if memory ran out.
+char *readStream(FILE *inFilePtr, size_t *size);
+
+// Writes object to out in the given format. Returns 0, or -1 with nothing
+// written if memory ran out; out reports its own write errors.
+int writeObject(OutputBuffer *out, ObjectFile *object, enum ObjectFormat format);
+
+// Little-endian words, as every binary LC-2K format stores them.
+static inline uint32_t
+loadWord(const char *bytes)
+{
+    const unsigned char *b = (const unsigned char *)bytes;
+    return b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static inline void
+writeWord(OutputBuffer *out, uint32_t word)
+{
+    char bytes[4] = {word & 0xFF, (word >> 8) & 0xFF, (word >> 16) & 0xFF, word >> 24};
+    writeBytes(out, bytes, 4);
+}
+
+// FNV-1a hash of a label, used to pick its first slot in a hash table
+static inline unsigned int
+hashLabel(const char *label, int length)
+{
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; ++i)
+        hash = (hash ^ (unsigned char)label[i]) * 16777619u;
+    return hash;
+}
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * Project 2
+ * Buffered output shared by the LC-2K assembler and linker
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+
+// Upper-case hex digits of every byte value, two characters per byte.
+static const char hexPairs[] =
+    "000102030405060708090A0B0C0D0E0F"
+    "101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F"
+    "303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F"
+    "505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F"
+    "707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F"
+    "909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+int openOutput(OutputBuffer *out, const char *path)
+{
+    out->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out->fd < 0)
+        return -1;
+    out->data = malloc(OUTBUFSIZE);
+    if (out->data == NULL)
+    {
+        close(out->fd);
+        return -2;
+    }
+    out->used = 0;
+    out->capacity = OUTBUFSIZE;
+    out->failed = false;
+    return 0;
+}
+
+int closeOutput(OutputBuffer *out)
+{
+    flushOutput(out);
+    if (close(out->fd) != 0)
+        out->failed = true;
+    free(out->data);
+    out->data = NULL;
+    return out->failed ? -1 : 0;
+}
+
+void discardOutput(OutputBuffer *out)
+{
+    out->used = 0;
+    if (out->fd >= 0 && (ftruncate(out->fd, 0) != 0 || lseek(out->fd, 0, SEEK_SET) != 0))
+        out->failed = true;
+}
+
+int openMemoryOutput(OutputBuffer *out)
+{
+    out->fd = -1;
+    out->capacity = 1 << 12;
+    out->data = malloc(out->capacity);
+    out->used = 0;
+    out->failed = false;
+    return out->data == NULL ? -1 : 0;
+}
+
+int takeOutput(OutputBuffer *out, char **data, size_t *size)
+{
+    if (out->failed)
+    {
+        free(out->data);
+        out->data = NULL;
+        return -1;
+    }
+    *data = out->data;
+    *size = out->used;
+    out->data = NULL;
+    return 0;
+}
+
+void flushOutput(OutputBuffer *out)
+{
+    if (out->fd < 0)
+    {
+        // a memory output doubles; after a failure, writes go nowhere
+        char *grown = out->failed ? NULL : realloc(out->data, 2 * out->capacity);
+        if (grown == NULL)
+        {
+            out->failed = true;
+            out->used = 0;
+            return;
+        }
+        out->data = grown;
+        out->capacity *= 2;
+        return;
+    }
+
+    size_t written = 0;
+    while (written < out->used && !out->failed)
+    {
+        ssize_t result = write(out->fd, out->data + written, out->used - written);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            out->failed = true;
+        else
+            written += result;
+    }
+    out->used = 0;
+}
+
+void writeBytes(OutputBuffer *out, const char *bytes, size_t length)
+{
+    while (length > 0)
+    {
+        if (out->used == out->capacity)
+            flushOutput(out);
+        size_t chunk = out->capacity - out->used;
+        if (chunk > length)
+            chunk = length;
+        memcpy(out->data + out->used, bytes, chunk);
+        out->used += chunk;
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+void writeDecimal(OutputBuffer *out, int value)
+{
+    char digits[12];
+    int length = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do
+    {
+        digits[sizeof(digits) - 1 - length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        digits[sizeof(digits) - 1 - length++] = '-';
+    writeBytes(out, digits + sizeof(digits) - length, length);
+}
+
+void writeHex(OutputBuffer *out, int word)
+{
+    if (out->capacity - out->used < 11)
+        flushOutput(out);
+    unsigned int bits = word;
+    char *p = out->data + out->used;
+    p[0] = '0';
+    p[1] = 'x';
+    memcpy(p + 2, hexPairs + 2 * (bits >> 24), 2);
+    memcpy(p + 4, hexPairs + 2 * ((bits >> 16) & 0xFF), 2);
+    memcpy(p + 6, hexPairs + 2 * ((bits >> 8) & 0xFF), 2);
+    memcpy(p + 8, hexPairs + 2 * (bits & 0xFF), 2);
+    p[10] = '\n';
+    out->used += 11;
+}
@@ -0,0 +1,65 @@
+/**
+ * Project 2
+ * Buffered output shared by the LC-2K assembler and linker
+ */
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bytes collected before a write(2) is issued.
+#define OUTBUFSIZE (1 << 20)
+
+typedef struct OutputBuffer OutputBuffer;
+
+// Formats text into a large user-space buffer and hands it to the kernel in
+// OUTBUFSIZE chunks. Any failed write is remembered and reported by
+// closeOutput. An output opened by openMemoryOutput has no file (fd is -1):
+// its buffer grows to hold everything written, for takeOutput to return.
+struct OutputBuffer
+{
+    int fd;
+    bool failed;
+    size_t used;
+    size_t capacity;
+    char *data;
+};
+
+// Opens path for writing, truncating it. Returns 0 on success, -1 if the
+// file cannot be opened and -2 if memory ran out.
+int openOutput(OutputBuffer *out, const char *path);
+
+// Flushes and closes the file. Returns 0 if every write succeeded, -1 otherwise.
+int closeOutput(OutputBuffer *out);
+
+// Drops everything written so far, for an output that must be left empty:
+// the buffered bytes and any the file already holds. A file that cannot be
+// truncated fails the output.
+void discardOutput(OutputBuffer *out);
+
+// Opens an output collected in memory. Returns 0 on success, -1 on error.
+int openMemoryOutput(OutputBuffer *out);
+
+// Ends a memory output, handing its bytes to the caller to free(). Returns 0
+// on success, or -1 and frees them if memory ran out along the way.
+int takeOutput(OutputBuffer *out, char **data, size_t *size);
+
+// Makes room in the buffer: writes it out, or grows it for a memory output.
+void flushOutput(OutputBuffer *out);
+void writeBytes(OutputBuffer *out, const char *bytes, size_t length);
+void writeDecimal(OutputBuffer *out, int value);
+
+// Writes a machine code word in the proper hex format, "0x%08X\n".
+void writeHex(OutputBuffer *out, int word);
+
+static inline void
+writeChar(OutputBuffer *out, char c)
+{
+    if (out->used == out->capacity)
+        flushOutput(out);
+    out->data[out->used++] = c;
+}
+
+#endif
@@ -0,0 +1,258 @@
+/**
+ * Project 2
+ * Requests the LC-2K client sends the server, and the server's responses
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "object.h"
+#include "outbuf.h"
+#include "request.h"
+
+typedef struct MessageReader MessageReader;
+
+// Reads the fields of a message body up to its end. failed is set by any
+// read past the end.
+struct MessageReader
+{
+    const char *next;
+    const char *end;
+    bool failed;
+};
+
+static void
+writeString(OutputBuffer *out, const char *string, size_t length)
+{
+    writeWord(out, length);
+    writeBytes(out, string, length);
+}
+
+// Writes all count bytes, retrying short writes. A peer that has gone away
+// fails the write rather than raising SIGPIPE.
+static int
+sendAll(int fd, const char *bytes, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t sent = send(fd, bytes, count, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return -1;
+        bytes += sent;
+        count -= sent;
+    }
+    return 0;
+}
+
+static int
+receiveAll(int fd, char *bytes, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t received = read(fd, bytes, count);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return -1;
+        bytes += received;
+        count -= received;
+    }
+    return 0;
+}
+
+// Sends the body written to the memory output body behind a header with
+// magic, and releases body.
+static int
+sendMessage(int fd, const char *magic, OutputBuffer *body)
+{
+    char *bytes;
+    size_t size;
+    if (takeOutput(body, &bytes, &size) != 0)
+        return -1;
+    OutputBuffer header;
+    char *headerBytes;
+    size_t headerSize;
+    if (openMemoryOutput(&header) != 0)
+    {
+        free(bytes);
+        return -1;
+    }
+    writeBytes(&header, magic, MESSAGEMAGICSIZE);
+    writeWord(&header, REQUESTVERSION);
+    writeWord(&header, size);
+    if (takeOutput(&header, &headerBytes, &headerSize) != 0)
+    {
+        free(bytes);
+        return -1;
+    }
+    int result = size <= MAXMESSAGESIZE && sendAll(fd, headerBytes, headerSize) == 0 &&
+                         sendAll(fd, bytes, size) == 0
+                     ? 0
+                     : -1;
+    free(headerBytes);
+    free(bytes);
+    return result;
+}
+
+// Receives a message with magic into a heap buffer for the caller to free.
+static int
+receiveMessage(int fd, const char *magic, char **body, size_t *size)
+{
+    char header[MESSAGEHEADERSIZE];
+    if (receiveAll(fd, header, sizeof(header)) != 0 || memcmp(header, magic, MESSAGEMAGICSIZE) ||
+        loadWord(header + 8) != REQUESTVERSION || loadWord(header + 12) > MAXMESSAGESIZE)
+        return -1;
+    *size = loadWord(header + 12);
+    *body = malloc(*size + 1);
+    if (*body == NULL)
+        return -1;
+    if (receiveAll(fd, *body, *size) != 0)
+    {
+        free(*body);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t
+readWord(MessageReader *reader)
+{
+    if (reader->end - reader->next < 4)
+    {
+        reader->failed = true;
+        return 0;
+    }
+    uint32_t word = loadWord(reader->next);
+    reader->next += 4;
+    return word;
+}
+
+// Returns where the next string starts and sets length, or NULL if it runs
+// past the end.
+static const char *
+readString(MessageReader *reader, size_t *length)
+{
+    *length = readWord(reader);
+    if (reader->failed || (size_t)(reader->end - reader->next) < *length)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    const char *string = reader->next;
+    reader->next += *length;
+    return string;
+}
+
+// Running out of memory fails the reader like a malformed message.
+static char *
+readArenaString(MessageReader *reader, Arena *arena, size_t *length)
+{
+    const char *string = readString(reader, length);
+    char *copy = string != NULL ? arenaString(arena, string, *length) : NULL;
+    if (copy == NULL)
+        reader->failed = true;
+    return copy;
+}
+
+int sendRequest(int fd, Request *request)
+{
+    OutputBuffer body;
+    if (openMemoryOutput(&body) != 0)
+        return -1;
+    writeWord(&body, request->tool);
+    writeWord(&body, request->umask);
+    writeWord(&body, request->argc);
+    for (int i = 0; i < request->argc; ++i)
+        writeString(&body, request->argv[i], strlen(request->argv[i]));
+    writeString(&body, request->cwd, strlen(request->cwd));
+    writeString(&body, request->input, request->inputSize);
+    return sendMessage(fd, REQUESTMAGIC, &body);
+}
+
+int receiveRequest(int fd, Request *request)
+{
+    char *body;
+    size_t size;
+    memset(request, 0, sizeof(*request));
+    if (receiveMessage(fd, REQUESTMAGIC, &body, &size) != 0)
+        return -1;
+
+    MessageReader reader = {body, body + size, false};
+    size_t length;
+    request->tool = readWord(&reader);
+    request->umask = readWord(&reader);
+    uint32_t argc = readWord(&reader);
+    // every string takes at least four bytes, which bounds what is allocated
+    if (reader.failed || (request->tool != TOOL_ASSEMBLER && request->tool != TOOL_LINKER) || argc == 0 ||
+        argc > (size_t)(reader.end - reader.next) / 4 ||
+        (request->argv = arenaAlloc(&request->arena, (argc + 1) * sizeof(char *))) == NULL)
+    {
+        free(body);
+        freeRequest(request);
+        return -1;
+    }
+    request->argc = argc;
+    for (uint32_t i = 0; i < argc; ++i)
+        request->argv[i] = readArenaString(&reader, &request->arena, &length);
+    request->argv[argc] = NULL;
+    request->cwd = readArenaString(&reader, &request->arena, &length);
+    request->input = readArenaString(&reader, &request->arena, &request->inputSize);
+
+    bool failed = reader.failed || reader.next != reader.end;
+    free(body);
+    if (failed)
+    {
+        freeRequest(request);
+        return -1;
+    }
+    return 0;
+}
+
+int sendResponse(int fd, int status, const char *output, size_t size)
+{
+    OutputBuffer body;
+    if (openMemoryOutput(&body) != 0)
+        return -1;
+    writeWord(&body, (uint32_t)status);
+    writeString(&body, output, size);
+    return sendMessage(fd, RESPONSEMAGIC, &body);
+}
+
+int receiveResponse(int fd, int *status, char **output, size_t *size)
+{
+    char *body;
+    size_t bodySize;
+    if (receiveMessage(fd, RESPONSEMAGIC, &body, &bodySize) != 0)
+        return -1;
+
+    // the output is moved to the front of the body, which is returned
+    MessageReader reader = {body, body + bodySize, false};
+    *status = (int32_t)readWord(&reader);
+    const char *string = readString(&reader, size);
+    if (reader.failed || reader.next != reader.end)
+    {
+        free(body);
+        return -1;
+    }
+    memmove(body, string, *size);
+    body[*size] = '\0';
+    *output = body;
+    return 0;
+}
+
+void freeRequest(Request *request)
+{
+    arenaFree(&request->arena);
+    request->argv = NULL;
+    request->cwd = NULL;
+    request->input = NULL;
+}
@@ -0,0 +1,73 @@
+/**
+ * Project 2
+ * Requests the LC-2K client sends the server, and the server's responses
+ */
+
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <stddef.h>
+
+#include "arena.h"
+
+// The client and server find each other through the Unix socket named by
+// this environment variable.
+#define SERVERENV "LC2K_SERVER"
+
+/*
+ * A request runs one assembler or linker command line as if the client had
+ * run it. Both directions send a message of
+ *     char     magic[8]            "LC2KREQ\0" or "LC2KRSP\0"
+ *     uint32   version             REQUESTVERSION
+ *     uint32   length              of the body, at most MAXMESSAGESIZE
+ * followed by the body. A request body is
+ *     uint32   tool, umask, argc
+ *     strings  argv[argc], cwd, input
+ * and a response body is
+ *     int32    status
+ *     string   output
+ * where a string is a uint32 length and that many bytes. All fields are
+ * little-endian.
+ */
+#define REQUESTMAGIC "LC2KREQ"
+#define RESPONSEMAGIC "LC2KRSP"
+#define MESSAGEMAGICSIZE 8
+#define REQUESTVERSION 1
+#define MESSAGEHEADERSIZE 16
+#define MAXMESSAGESIZE (1 << 28)
+
+typedef struct Request Request;
+
+enum Tool
+{
+    TOOL_ASSEMBLER,
+    TOOL_LINKER
+};
+
+// argv[0] is the name the client was run as. input holds the client's
+// standard input when the assembler is to read a source named "-", and is
+// empty otherwise. Received strings are NUL-terminated copies in arena.
+struct Request
+{
+    enum Tool tool;
+    unsigned int umask;
+    int argc;
+    char **argv;
+    char *cwd;
+    char *input;
+    size_t inputSize;
+    Arena arena;
+};
+
+// Each returns 0 on success and -1 if the socket fails or the message is
+// malformed.
+int sendRequest(int fd, Request *request);
+int receiveRequest(int fd, Request *request);
+int sendResponse(int fd, int status, const char *output, size_t size);
+
+// The output is a heap buffer, NUL-terminated past size, for the caller to free.
+int receiveResponse(int fd, int *status, char **output, size_t *size);
+
+void freeRequest(Request *request);
+
+#endif
@@ -0,0 +1,564 @@
+/**
+ * Project 2
+ * LC-2K simulator, as a library the simulator command runs machines with
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "simulate.h"
+
+// Splits word into its fields. Fields an opcode does not use are decoded
+// anyway; they are never read.
+static inline Decoded
+decodeWord(int word)
+{
+    Decoded decoded;
+    decoded.opcode = (word >> 22) & 0x7;
+    decoded.regA = (word >> 19) & 0x7;
+    decoded.regB = (word >> 16) & 0x7;
+    decoded.dest = word & 0x7;
+    decoded.offset = (int16_t)(word & 0xFFFF);
+    return decoded;
+}
+
+// Parses the number that starts line: hex after "0x", decimal otherwise,
+// either wrapping to 32 bits. Whatever follows it is ignored. Returns -1 if
+// the line does not start with a number.
+static int
+parseWord(const char *line, const char *end, int *word)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+        ++line;
+    bool negative = false;
+    if (line < end && (*line == '-' || *line == '+'))
+        negative = *line++ == '-';
+    unsigned int base = 10;
+    if (end - line > 2 && line[0] == '0' && (line[1] | 0x20) == 'x')
+    {
+        base = 16;
+        line += 2;
+    }
+
+    uint32_t value = 0;
+    const char *digits = line;
+    for (; line < end; ++line)
+    {
+        unsigned int digit;
+        if (*line >= '0' && *line <= '9')
+            digit = *line - '0';
+        else if (base == 16 && (*line | 0x20) >= 'a' && (*line | 0x20) <= 'f')
+            digit = (*line | 0x20) - 'a' + 10;
+        else
+            break;
+        value = value * base + digit;
+    }
+    if (line == digits)
+        return -1;
+    *word = (int)(negative ? 0u - value : value);
+    return 0;
+}
+
+int loadMachine(Machine *machine, const char *text, size_t size)
+{
+    machine->pc = 0;
+    memset(machine->reg, 0, sizeof(machine->reg));
+    machine->numMemory = 0;
+    machine->numInstructionsExecuted = 0;
+    machine->numTranslated = 0;
+    machine->profiled = false;
+    machine->profile = NULL;
+
+    const char *end = text + size;
+    while (text < end)
+    {
+        const char *newline = memchr(text, '\n', end - text);
+        const char *lineEnd = newline != NULL ? newline : end;
+        if (machine->numMemory == MEMORYSIZE ||
+            parseWord(text, lineEnd, &machine->mem[machine->numMemory]) != 0)
+            return machine->numMemory + 1;
+        ++machine->numMemory;
+        text = lineEnd + 1;
+    }
+
+    // the rest of memory is 0, which decodes to all-zero fields
+    memset(machine->mem + machine->numMemory, 0, (MEMORYSIZE - machine->numMemory) * sizeof(int));
+    memset(machine->code + machine->numMemory, 0, (MEMORYSIZE - machine->numMemory) * sizeof(Decoded));
+    for (int i = 0; i < machine->numMemory; ++i)
+        machine->code[i] = decodeWord(machine->mem[i]);
+    return 0;
+}
+
+void storeWord(Machine *machine, int address, int word)
+{
+    machine->mem[address] = word;
+    machine->code[address] = decodeWord(word);
+    machine->numTranslated = 0;
+}
+
+// Executes the machine one decoded instruction at a time, for runMachine.
+static enum RunStatus
+runReference(Machine *machine, uint64_t budget)
+{
+    // the hot state lives in locals for the loop and is stored back once
+    int *reg = machine->reg;
+    int *mem = machine->mem;
+    Decoded *code = machine->code;
+    int pc = machine->pc;
+    uint64_t executed = 0;
+    enum RunStatus status = RUN_BUDGET;
+
+    while (executed < budget)
+    {
+        if ((unsigned int)pc >= MEMORYSIZE)
+        {
+            status = RUN_BAD_PC;
+            break;
+        }
+        const Decoded *inst = &code[pc];
+        unsigned int address;
+        switch (inst->opcode)
+        {
+        case OP_ADD:
+            // registers wrap like the 32-bit machine's, without signed overflow
+            reg[inst->dest] = (int)((unsigned int)reg[inst->regA] + (unsigned int)reg[inst->regB]);
+            ++pc;
+            break;
+        case OP_NOR:
+            reg[inst->dest] = ~(reg[inst->regA] | reg[inst->regB]);
+            ++pc;
+            break;
+        case OP_LW:
+            address = (unsigned int)reg[inst->regA] + (unsigned int)inst->offset;
+            if (address >= MEMORYSIZE)
+            {
+                status = RUN_BAD_ADDRESS;
+                goto stop;
+            }
+            reg[inst->regB] = mem[address];
+            ++pc;
+            break;
+        case OP_SW:
+            address = (unsigned int)reg[inst->regA] + (unsigned int)inst->offset;
+            if (address >= MEMORYSIZE)
+            {
+                status = RUN_BAD_ADDRESS;
+                goto stop;
+            }
+            mem[address] = reg[inst->regB];
+            code[address] = decodeWord(mem[address]);
+            machine->numTranslated = 0;
+            ++pc;
+            break;
+        case OP_BEQ:
+            pc += reg[inst->regA] == reg[inst->regB] ? 1 + inst->offset : 1;
+            break;
+        case OP_JALR:
+            // regB is written first, so jalr with regA == regB goes on to pc + 1
+            reg[inst->regB] = pc + 1;
+            pc = reg[inst->regA];
+            break;
+        case OP_HALT:
+            ++pc;
+            ++executed;
+            status = RUN_HALTED;
+            goto stop;
+        default: // noop
+            ++pc;
+            break;
+        }
+        ++executed;
+    }
+
+stop:
+    machine->pc = pc;
+    machine->numInstructionsExecuted += executed;
+    return status;
+}
+
+#if defined(__GNUC__)
+
+// The longest run of noops a single op executes. A sw into a word an op of an
+// earlier word may have fused retranslates this many ops before it.
+#define MAXFUSED 255
+
+// What an op executes, indexing the threaded engine's handlers. The first
+// eight are the opcodes alone.
+enum OpKind
+{
+    KIND_JUMP = OP_NOOP + 1, // a beq of a register with itself
+    KIND_NOOPS,              // length noops
+    KIND_LWBEQ,              // a lw, then a beq
+    KIND_ADDBEQ,             // an add, then a beq
+    KIND_EXTEND,             // the word past the translated ones
+    KIND_OFFEND,             // the word past memory
+    KIND_STALE,              // a word a sw wrote, translated if executed
+    NUMKINDS
+};
+
+// Translates the word at pc into its op, fusing it with the op of the next
+// word where it can; that op must be current. Only words below limit, the
+// end of the translation, are fused, since a store past it does not look
+// for ops that fused the word it writes.
+static void
+translateOp(Machine *machine, int pc, int limit, const void *const *handlers)
+{
+    ThreadedOp *op = &machine->ops[pc];
+    const Decoded *inst = &machine->code[pc];
+    op->offset = inst->offset;
+    op->regA = inst->regA;
+    op->regB = inst->regB;
+    op->dest = inst->dest;
+    op->length = 1;
+    int kind = inst->opcode;
+    if (kind == OP_BEQ && inst->regA == inst->regB)
+        kind = KIND_JUMP;
+    op->single = handlers[kind];
+
+    // A noop joins the run of noops the next op executes, so a run stops
+    // short of a stale op and of the end of the translation.
+    const ThreadedOp *next = &machine->ops[pc + 1];
+    const Decoded *nextInst = &machine->code[pc + 1];
+    if (kind == OP_NOOP && (next->handler == handlers[OP_NOOP] || next->handler == handlers[KIND_NOOPS]))
+    {
+        kind = KIND_NOOPS;
+        op->length = next->length < MAXFUSED ? next->length + 1 : MAXFUSED;
+    }
+    else if (pc + 1 < limit && (kind == OP_LW || kind == OP_ADD) && nextInst->opcode == OP_BEQ)
+    {
+        kind = kind == OP_LW ? KIND_LWBEQ : KIND_ADDBEQ;
+        op->regA2 = nextInst->regA;
+        op->regB2 = nextInst->regB;
+        op->offset2 = nextInst->offset;
+        op->length = 2;
+    }
+    if (op->length > 1)
+        machine->covered[pc + 1] = 1;
+    op->handler = handlers[kind];
+}
+
+// Translates the words from first up to limit, backwards so each op sees the
+// one after it already translated. The op at limit translates the rest of
+// memory when it is reached or, past memory, faults.
+static void
+translateRange(Machine *machine, int first, int limit, const void *const *handlers)
+{
+    // no op before first fused the word at first, which was then the end
+    int clearTo = limit < MEMORYSIZE ? limit + 1 : MEMORYSIZE;
+    memset(machine->covered + first, 0, clearTo - first);
+    ThreadedOp *end = &machine->ops[limit];
+    end->handler = end->single = handlers[limit < MEMORYSIZE ? KIND_EXTEND : KIND_OFFEND];
+    end->length = 1;
+    for (int pc = limit - 1; pc >= first; --pc)
+        translateOp(machine, pc, limit, handlers);
+    machine->numTranslated = limit;
+}
+
+// Executes the machine's threaded code. After a load, or a store by the
+// reference engine, only the loaded words are translated to begin with; the
+// rest of memory is translated if the pc ever leaves them.
+static enum RunStatus
+runThreaded(Machine *machine, uint64_t budget)
+{
+    static const void *const handlers[NUMKINDS] = {
+        [OP_ADD] = &&doAdd,
+        [OP_NOR] = &&doNor,
+        [OP_LW] = &&doLw,
+        [OP_SW] = &&doSw,
+        [OP_BEQ] = &&doBeq,
+        [OP_JALR] = &&doJalr,
+        [OP_HALT] = &&doHalt,
+        [OP_NOOP] = &&doNoop,
+        [KIND_JUMP] = &&doJump,
+        [KIND_NOOPS] = &&doNoops,
+        [KIND_LWBEQ] = &&doLwBeq,
+        [KIND_ADDBEQ] = &&doAddBeq,
+        [KIND_EXTEND] = &&doExtend,
+        [KIND_OFFEND] = &&doOffEnd,
+        [KIND_STALE] = &&doStale,
+    };
+    // a profiled run counts wherever control leaves straight-line code
+    static const void *const profiledHandlers[NUMKINDS] = {
+        [OP_ADD] = &&doAdd,
+        [OP_NOR] = &&doNor,
+        [OP_LW] = &&doLw,
+        [OP_SW] = &&doSw,
+        [OP_BEQ] = &&doBeqCounted,
+        [OP_JALR] = &&doJalrCounted,
+        [OP_HALT] = &&doHaltCounted,
+        [OP_NOOP] = &&doNoop,
+        [KIND_JUMP] = &&doJumpCounted,
+        [KIND_NOOPS] = &&doNoops,
+        [KIND_LWBEQ] = &&doLwBeqCounted,
+        [KIND_ADDBEQ] = &&doAddBeqCounted,
+        [KIND_EXTEND] = &&doExtend,
+        [KIND_OFFEND] = &&doOffEnd,
+        [KIND_STALE] = &&doStale,
+    };
+
+    Profile *profile = machine->profile;
+    const void *const *table = profile != NULL ? profiledHandlers : handlers;
+    if (machine->profiled != (profile != NULL))
+        machine->numTranslated = 0;
+    machine->profiled = profile != NULL;
+
+    ThreadedOp *ops = machine->ops;
+    if (machine->numTranslated == 0)
+        translateRange(machine, 0, machine->numMemory > 0 ? machine->numMemory : 1, table);
+    int limit = machine->numTranslated;
+
+    int *reg = machine->reg;
+    int *mem = machine->mem;
+    int pc = machine->pc;
+    uint64_t remaining = budget;
+    enum RunStatus status = RUN_BUDGET;
+    const ThreadedOp *op;
+    unsigned int address;
+
+    // Every handler ends in its own dispatch, so the indirect jumps predict
+    // per handler. An op's instructions are counted before it runs; one that
+    // faults gives them back. With fewer left in the budget than an op
+    // executes, only its first instruction runs.
+#define DISPATCH()                                          \
+    do                                                      \
+    {                                                       \
+        op = &ops[pc];                                      \
+        if (__builtin_expect(remaining < op->length, 0))    \
+        {                                                   \
+            if (remaining == 0)                             \
+                goto stop;                                  \
+            --remaining;                                    \
+            goto *op->single;                               \
+        }                                                   \
+        remaining -= op->length;                            \
+        goto *op->handler;                                  \
+    } while (0)
+
+    // a branch may leave the translated words, or memory
+#define BRANCHED()                                          \
+    do                                                      \
+    {                                                       \
+        if ((unsigned int)pc >= (unsigned int)limit)        \
+            goto branchedOut;                               \
+        DISPATCH();                                         \
+    } while (0)
+
+    if (profile != NULL && (unsigned int)pc < MEMORYSIZE)
+        ++profile->starts[pc];
+    if ((unsigned int)pc >= (unsigned int)limit)
+        goto branchedOut;
+    DISPATCH();
+
+doAdd:
+    reg[op->dest] = (int)((unsigned int)reg[op->regA] + (unsigned int)reg[op->regB]);
+    ++pc;
+    DISPATCH();
+doNor:
+    reg[op->dest] = ~(reg[op->regA] | reg[op->regB]);
+    ++pc;
+    DISPATCH();
+doLw:
+    address = (unsigned int)reg[op->regA] + (unsigned int)op->offset;
+    if (address >= MEMORYSIZE)
+    {
+        remaining += 1;
+        status = RUN_BAD_ADDRESS;
+        goto stop;
+    }
+    reg[op->regB] = mem[address];
+    ++pc;
+    DISPATCH();
+doSw:
+    address = (unsigned int)reg[op->regA] + (unsigned int)op->offset;
+    if (address >= MEMORYSIZE)
+    {
+        remaining += 1;
+        status = RUN_BAD_ADDRESS;
+        goto stop;
+    }
+    mem[address] = reg[op->regB];
+    machine->code[address] = decodeWord(mem[address]);
+    // Most stores are to data, so the op of the word written waits until it
+    // is executed to be translated. Ops before it that fused the word are
+    // translated now.
+    if (address < (unsigned int)limit)
+    {
+        ops[address].handler = ops[address].single = table[KIND_STALE];
+        ops[address].length = 1;
+        if (machine->covered[address])
+        {
+            for (int fused = (int)address - 1; fused >= 0 && fused > (int)address - MAXFUSED; --fused)
+                translateOp(machine, fused, limit, table);
+        }
+    }
+    ++pc;
+    DISPATCH();
+doBeq:
+    pc += reg[op->regA] == reg[op->regB] ? 1 + op->offset : 1;
+    BRANCHED();
+doJump:
+    pc += 1 + op->offset;
+    BRANCHED();
+doJalr:
+    reg[op->regB] = pc + 1;
+    pc = reg[op->regA];
+    BRANCHED();
+doHalt:
+    ++pc;
+    status = RUN_HALTED;
+    goto stop;
+doNoop:
+    ++pc;
+    DISPATCH();
+doNoops:
+    pc += op->length;
+    DISPATCH();
+doLwBeq:
+    address = (unsigned int)reg[op->regA] + (unsigned int)op->offset;
+    if (address >= MEMORYSIZE)
+    {
+        remaining += 2;
+        status = RUN_BAD_ADDRESS;
+        goto stop;
+    }
+    reg[op->regB] = mem[address];
+    pc += reg[op->regA2] == reg[op->regB2] ? 2 + op->offset2 : 2;
+    BRANCHED();
+doAddBeq:
+    reg[op->dest] = (int)((unsigned int)reg[op->regA] + (unsigned int)reg[op->regB]);
+    pc += reg[op->regA2] == reg[op->regB2] ? 2 + op->offset2 : 2;
+    BRANCHED();
+doStale:
+    remaining += 1;
+    translateOp(machine, pc, limit, table);
+    DISPATCH();
+doBeqCounted:
+    if (reg[op->regA] != reg[op->regB])
+    {
+        ++pc;
+        DISPATCH();
+    }
+    ++profile->exits[pc];
+    pc += 1 + op->offset;
+    goto counted;
+doJumpCounted:
+    ++profile->exits[pc];
+    pc += 1 + op->offset;
+    goto counted;
+doJalrCounted:
+    ++profile->exits[pc];
+    reg[op->regB] = pc + 1;
+    pc = reg[op->regA];
+    if ((unsigned int)pc < MEMORYSIZE)
+        ++profile->calls[pc];
+    goto counted;
+doHaltCounted:
+    ++profile->exits[pc];
+    ++pc;
+    status = RUN_HALTED;
+    goto stop;
+doLwBeqCounted:
+    address = (unsigned int)reg[op->regA] + (unsigned int)op->offset;
+    if (address >= MEMORYSIZE)
+    {
+        remaining += 2;
+        status = RUN_BAD_ADDRESS;
+        goto stop;
+    }
+    reg[op->regB] = mem[address];
+    if (reg[op->regA2] != reg[op->regB2])
+    {
+        pc += 2;
+        BRANCHED();
+    }
+    ++profile->exits[pc + 1];
+    pc += 2 + op->offset2;
+    goto counted;
+doAddBeqCounted:
+    reg[op->dest] = (int)((unsigned int)reg[op->regA] + (unsigned int)reg[op->regB]);
+    if (reg[op->regA2] != reg[op->regB2])
+    {
+        pc += 2;
+        BRANCHED();
+    }
+    ++profile->exits[pc + 1];
+    pc += 2 + op->offset2;
+    goto counted;
+counted:
+    if ((unsigned int)pc < MEMORYSIZE)
+        ++profile->entries[pc];
+    BRANCHED();
+doExtend:
+    remaining += 1;
+    translateRange(machine, limit, MEMORYSIZE, table);
+    limit = MEMORYSIZE;
+    DISPATCH();
+doOffEnd:
+    remaining += 1;
+    status = RUN_BAD_PC;
+    goto stop;
+branchedOut:
+    if ((unsigned int)pc < MEMORYSIZE)
+    {
+        translateRange(machine, limit, MEMORYSIZE, table);
+        limit = MEMORYSIZE;
+        DISPATCH();
+    }
+    if (remaining != 0)
+        status = RUN_BAD_PC;
+
+#undef BRANCHED
+#undef DISPATCH
+
+stop:
+    // the run reached the word it stopped at without executing it
+    if (profile != NULL && status != RUN_HALTED && (unsigned int)pc < MEMORYSIZE)
+        ++profile->stops[pc];
+    machine->pc = pc;
+    machine->numInstructionsExecuted += budget - remaining;
+    return status;
+}
+
+#else
+
+// Without computed gotos the threaded engine is the reference one.
+static enum RunStatus
+runThreaded(Machine *machine, uint64_t budget)
+{
+    return runReference(machine, budget);
+}
+
+#endif
+
+enum RunStatus runMachine(Machine *machine, enum Engine engine, uint64_t budget)
+{
+    if (engine == ENGINE_THREADED)
+        return runThreaded(machine, budget);
+    return runReference(machine, budget);
+}
+
+void countExecutions(const Profile *profile, uint64_t *executed)
+{
+    // a word executes as often as control reaches it, whether in order or
+    // not, less the runs that stopped there; what it does not leave by a
+    // branch falls through to the next word
+    uint64_t fallThrough = 0;
+    for (int i = 0; i < MEMORYSIZE; ++i)
+    {
+        executed[i] = profile->entries[i] + profile->starts[i] + fallThrough - profile->stops[i];
+        fallThrough = executed[i] - profile->exits[i];
+    }
+}
+
+void printState(FILE *stream, Machine *machine)
+{
+    fprintf(stream, "\n@@@\nstate:\n");
+    fprintf(stream, "\tpc %d\n", machine->pc);
+    fprintf(stream, "\tmemory:\n");
+    for (int i = 0; i < machine->numMemory; ++i)
+        fprintf(stream, "\t\tmem[ %d ] 0x%08X\n", i, machine->mem[i]);
+    fprintf(stream, "\tregisters:\n");
+    for (int i = 0; i < NUMREGS; ++i)
+        fprintf(stream, "\t\treg[ %d ] 0x%08X\n", i, machine->reg[i]);
+    fprintf(stream, "end state\n");
+}
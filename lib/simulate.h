@@ -0,0 +1,151 @@
+/**
+ * Project 2
+ * LC-2K simulator, as a library the simulator command runs machines with
+ */
+
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Words of memory; addresses and the pc must stay below it.
+#define MEMORYSIZE 65536
+#define NUMREGS 8
+
+// No limit on the instructions runMachine executes.
+#define NOBUDGET UINT64_MAX
+
+typedef struct Decoded Decoded;
+typedef struct ThreadedOp ThreadedOp;
+typedef struct Profile Profile;
+typedef struct Machine Machine;
+
+enum Opcode
+{
+    OP_ADD,
+    OP_NOR,
+    OP_LW,
+    OP_SW,
+    OP_BEQ,
+    OP_JALR,
+    OP_HALT,
+    OP_NOOP
+};
+
+// How runMachine executes. The reference engine dispatches on every decoded
+// instruction in a switch. The threaded engine translates memory into
+// direct-threaded code, one op per word, in which an op may execute a short
+// straight-line sequence at once (a run of noops, or an lw or add followed by
+// a beq). Both give the same results; where the compiler lacks computed
+// gotos, the threaded engine is the reference one.
+enum Engine
+{
+    ENGINE_REFERENCE,
+    ENGINE_THREADED
+};
+
+// Why runMachine stopped. An instruction that would fault is not executed,
+// so the pc is left at it.
+enum RunStatus
+{
+    RUN_HALTED,      // a halt was executed
+    RUN_BUDGET,      // the budget ran out first
+    RUN_BAD_PC,      // the pc left memory
+    RUN_BAD_ADDRESS  // a lw or sw addressed a word outside memory
+};
+
+// One memory word split into its fields, with offset sign-extended. Every
+// word is decoded whether or not it is ever executed; a sw keeps the word it
+// writes decoded too.
+struct Decoded
+{
+    unsigned char opcode; // an enum Opcode
+    unsigned char regA;
+    unsigned char regB;
+    unsigned char dest;
+    int offset;
+};
+
+// The threaded code for the word at one address. handler executes length
+// instructions from there; single executes only the first, for when fewer
+// remain in the budget. The second instruction of a fused pair keeps its
+// fields in regA2, regB2 and offset2.
+struct ThreadedOp
+{
+    const void *handler;
+    const void *single;
+    int offset;
+    int offset2;
+    unsigned char regA;
+    unsigned char regB;
+    unsigned char dest;
+    unsigned char regA2;
+    unsigned char regB2;
+    unsigned char length;
+};
+
+// What profiled runs count, by address. A taken beq or a jalr went to the
+// word entries times, calls of them by a jalr. The word's instruction did
+// not go on to the next word (a taken beq, a jalr or a halt) exits times.
+// starts runs started at the word, and stops ended at it without executing
+// it. countExecutions turns these into how often each word executed.
+struct Profile
+{
+    uint64_t entries[MEMORYSIZE];
+    uint64_t calls[MEMORYSIZE];
+    uint64_t exits[MEMORYSIZE];
+    uint64_t starts[MEMORYSIZE];
+    uint64_t stops[MEMORYSIZE];
+};
+
+// numMemory is the number of words the executable loaded; the rest of memory
+// starts as 0. ops is the threaded code: the ops below numTranslated are
+// current, and the one at it translates more or, past memory, faults; none
+// are while numTranslated is 0. covered marks the words an op of an earlier
+// word may have fused. profile, unless NULL, is what the threaded engine
+// counts into; profiled says whether ops were translated to count. Machines
+// share nothing, so any number may run at once.
+struct Machine
+{
+    int pc;
+    int reg[NUMREGS];
+    int numMemory;
+    uint64_t numInstructionsExecuted;
+    int mem[MEMORYSIZE];
+    Decoded code[MEMORYSIZE];
+    int numTranslated;
+    bool profiled;
+    Profile *profile;
+    unsigned char covered[MEMORYSIZE];
+    ThreadedOp ops[MEMORYSIZE + 1];
+};
+
+// Loads the executable of size bytes at text, one word per line as the
+// linker writes it ("0x%08X"; decimal is accepted too), into a reset
+// machine that profiles nothing. Returns 0 on success, otherwise the line
+// (from 1) that is not a word or does not fit in memory.
+int loadMachine(Machine *machine, const char *text, size_t size);
+
+// Writes word to memory at address, below MEMORYSIZE, as a sw would; for
+// setting up a loaded machine.
+void storeWord(Machine *machine, int address, int word);
+
+// Executes instructions from machine->pc with engine until a halt, a fault or
+// budget instructions, whichever comes first. Engines may be switched
+// between calls. The threaded engine counts into machine->profile, set to
+// a zeroed Profile after loading, at a cost only when control leaves
+// straight-line code; the reference engine counts nothing.
+enum RunStatus runMachine(Machine *machine, enum Engine engine, uint64_t budget);
+
+// Fills executed with how often each word executed in the runs profile
+// counted.
+void countExecutions(const Profile *profile, uint64_t *executed);
+
+// Prints the machine's pc, loaded memory and registers in the format of the
+// project's simulator.
+void printState(FILE *stream, Machine *machine);
+
+#endif